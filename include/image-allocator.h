@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class ImageAllocator
+ * @brief The ImageAllocator class is the interface for supplying pixel memory to the library.
+ * 
+ * Implementations can serve allocations from a size-class pool, a per-request arena or any other
+ * strategy that suits the workload. An allocator is used by Image for the buffers it allocates and by
+ * ImageDecoder for all memory used while decoding, including the decoded pixels. Memory may be
+ * deallocated on a different thread than it was allocated on, so implementations shared between
+ * threads must be thread-safe. An allocator must outlive all memory allocated from it.
+ */
+class ImageAllocator {
+public:
+    /**
+     * @brief Alignment of the blocks returned by the default allocator, which suits aligned SIMD loads
+     * and keeps the first row of a buffer on cache line boundaries.
+     */
+    static constexpr size_t ALIGNMENT = 64;
+
+    /**
+     * @brief Size from which the default allocator maps blocks directly from the operating system and
+     * advises transparent huge pages for them, to reduce TLB misses on very large images.
+     */
+    static constexpr size_t HUGE_PAGE_THRESHOLD = size_t(16) << 20;
+
+    /**
+     * @brief Virtual destructor for derived allocators.
+     */
+    virtual ~ImageAllocator() = default;
+
+    /**
+     * @brief Allocates a block of memory suitably aligned for any fundamental type. Alignment to
+     * ALIGNMENT is recommended, as the default allocator provides it.
+     * 
+     * @param size Size of the block in bytes.
+     * @return Pointer to the block, or nullptr if the allocation failed.
+     */
+    virtual void* allocate(size_t size) = 0;
+
+    /**
+     * @brief Releases a block of memory previously returned by allocate().
+     * 
+     * @param pointer Pointer to the block.
+     * @param size Size of the block in bytes, as passed to allocate().
+     */
+    virtual void deallocate(void* pointer, size_t size) = 0;
+
+    /**
+     * @brief Retrieves the allocator used when none is specified. Its blocks are aligned to ALIGNMENT,
+     * and blocks of at least HUGE_PAGE_THRESHOLD bytes are backed by transparent huge pages where available.
+     * 
+     * @return The default allocator.
+     */
+    static ImageAllocator& getDefault();
+};
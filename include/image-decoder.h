@@ -1,6 +1,11 @@
 #pragma once
 
 #include <string>
+#include <span>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
 #include "image.h"
 
 /**
@@ -12,6 +17,127 @@
  */
 class ImageDecoder {
 public:
+
+    /**
+     * @enum Format
+     * @brief Encoded image formats recognized by the decoder.
+     */
+    enum class Format: int32_t {
+        Unknown = 0,
+        PNG     = 1,
+        JPEG    = 2,
+        BMP     = 3,
+        GIF     = 4,
+        PSD     = 5,
+        PIC     = 6,
+        PNM     = 7,
+        HDR     = 8,
+        TGA     = 9
+    };
+
+    /**
+     * @struct Info
+     * @brief Image properties read from the header of an encoded image.
+     */
+    struct Info {
+        int32_t width = 0;          // Width of the image in pixels.
+        int32_t height = 0;         // Height of the image in pixels.
+        int32_t channels = 0;       // Number of channels stored in the image.
+        bool is16Bit = false;       // Whether the image stores 16 bits per channel.
+        bool isHDR = false;         // Whether the image stores high dynamic range (floating point) data.
+        Format format = Format::Unknown;    // Encoded format of the image.
+    };
+
+    /**
+     * @enum InputMode
+     * @brief Specifies how image files are read by the decoder.
+     */
+    enum class InputMode: int32_t {
+        Stdio           = 0,    // Buffered reads through the C standard library.
+        MemoryMapped    = 1     // Read-only memory mapping advised for sequential access. Avoids copying
+                                // the file through stdio buffers, which pays off for large files. Falls
+                                // back to Stdio on platforms without memory mapping.
+    };
+
+    /**
+     * @enum SampleDepth
+     * @brief Specifies the sample type of decoded images.
+     */
+    enum class SampleDepth: int32_t {
+        Always8Bit  = 0,    // Convert every image to 8-bit samples (Image::SampleType::U8).
+        Native      = 1     // Keep 16-bit images at 16 bits (Image::SampleType::U16) and decode high dynamic
+                            // range images to floats (Image::SampleType::F32). Other images stay 8-bit.
+    };
+
+    /**
+     * @class Reader
+     * @brief Source of encoded image bytes for decoding from streams such as pipes, sockets,
+     * decompression streams or archive members.
+     * 
+     * The decoder pulls data through read(), may skip ahead (or, by a few bytes, back) with skip()
+     * and checks for the end of the data with eof(). Exceptions thrown by these methods are
+     * propagated to the caller of the decoder.
+     */
+    class Reader {
+    public:
+        virtual ~Reader() = default;
+
+        /**
+         * @brief Reads up to `size` bytes into `buffer`.
+         * 
+         * @param buffer The buffer that receives the bytes.
+         * @param size Maximum number of bytes to read.
+         * @return Number of bytes read, which may be less than requested. Zero signals the end of the data.
+         */
+        virtual size_t read(uint8_t* buffer, size_t size) = 0;
+
+        /**
+         * @brief Skips over the next `count` bytes. A negative count moves back by that many bytes.
+         * 
+         * @param count Number of bytes to skip.
+         */
+        virtual void skip(int64_t count) = 0;
+
+        /**
+         * @brief Checks whether the end of the data has been reached.
+         * 
+         * @return True if no more bytes can be read, false otherwise.
+         */
+        virtual bool eof() = 0;
+    };
+
+    /**
+     * @struct BatchResult
+     * @brief Outcome of decoding a single item of a batch.
+     */
+    struct BatchResult {
+        Image image;            // The decoded image. Empty if decoding failed.
+        std::string error;      // Description of the failure. Empty if decoding succeeded.
+
+        /**
+         * @brief Checks whether the item was decoded successfully.
+         * 
+         * @return True if the item was decoded, false otherwise.
+         */
+        bool succeeded() const { return error.empty(); }
+    };
+
+    /**
+     * @brief Callback reporting batch progress as the number of finished items out of the total.
+     * Calls are serialized, but may happen on any of the worker threads.
+     */
+    using ProgressCallback = std::function<void(size_t completed, size_t total)>;
+
+private:
+    InputMode m_input_mode = InputMode::Stdio;  // How image files are read.
+    ImageAllocator* m_allocator = nullptr;      // Allocator for decode memory, or nullptr for the default.
+    SampleDepth m_sample_depth = SampleDepth::Always8Bit;   // Sample type of decoded images.
+    int32_t m_channels = 0;                     // Channel count of decoded images, or 0 to keep the stored count.
+    int32_t m_target_width = 0;                 // Width that JPEG images are reduced towards, or 0 for no limit.
+    int32_t m_target_height = 0;                // Height that JPEG images are reduced towards, or 0 for no limit.
+
+public:
+
     /**
      * @brief Default constructor for ImageDecoder.
      */
@@ -31,6 +157,95 @@ public:
      */
     ImageDecoder& operator=(const ImageDecoder& other) = delete;
 
+    /**
+     * @brief Sets how image files are read by the file path based decode methods.
+     * 
+     * @param input_mode The input mode.
+     */
+    void setInputMode(InputMode input_mode);
+
+    /**
+     * @brief Retrieves how image files are read by the file path based decode methods.
+     * 
+     * @return The input mode.
+     */
+    InputMode getInputMode() const;
+
+    /**
+     * @brief Sets the allocator that decoding draws memory from, including the pixels of the
+     * returned images. The images hand their pixels back to it when destroyed, so the allocator
+     * must outlive them. Not thread-safe with respect to concurrent decodes on this decoder.
+     * 
+     * @param allocator The allocator, or nullptr to use the default allocator.
+     */
+    void setAllocator(ImageAllocator* allocator);
+
+    /**
+     * @brief Retrieves the allocator that decoding draws memory from.
+     * 
+     * @return The allocator, or nullptr if none is set.
+     */
+    ImageAllocator* getAllocator() const;
+
+    /**
+     * @brief Sets the sample type of decoded images, for all decode methods.
+     * 
+     * @param sample_depth The sample depth.
+     */
+    void setSampleDepth(SampleDepth sample_depth);
+
+    /**
+     * @brief Retrieves the sample type of decoded images.
+     * 
+     * @return The sample depth.
+     */
+    SampleDepth getSampleDepth() const;
+
+    /**
+     * @brief Sets the channel count that all decode methods convert images to: 1 (gray), 2 (gray
+     * and alpha), 3 (RGB) or 4 (RGBA). The conversion happens row by row while decoding, so it
+     * costs no extra pass over the pixels. Alpha is added as fully opaque where the image has none.
+     * 
+     * @param channels The channel count, or 0 to keep the channel count stored in the image.
+     * @throws std::invalid_argument If the channel count is not between 0 and 4.
+     */
+    void setChannels(int32_t channels);
+
+    /**
+     * @brief Retrieves the channel count that decoded images are converted to.
+     * 
+     * @return The channel count, or 0 if images keep the channel count stored in them.
+     */
+    int32_t getChannels() const;
+
+    /**
+     * @brief Sets the size that decoded images are needed at, e.g., the size of a thumbnail. JPEG images are
+     * then decoded with libjpeg, reduced by the largest factor of 1/2, 1/4 or 1/8 that keeps them at least as
+     * large as the target size. The reduction happens in the inverse DCT, so the pixels that would be thrown
+     * away are never computed. The result is not resized to the exact target size (see ImageResizer). Other
+     * formats are decoded at their full size.
+     * 
+     * @param width Width that images are needed at, or 0 for no limit on the width.
+     * @param height Height that images are needed at, or 0 for no limit on the height. With both 0, images
+     * are decoded at their full size, which is the default.
+     * @throws std::invalid_argument If a dimension is negative.
+     */
+    void setTargetSize(int32_t width, int32_t height);
+
+    /**
+     * @brief Retrieves the width that decoded images are needed at.
+     * 
+     * @return The target width, or 0 if there is no limit on the width.
+     */
+    int32_t getTargetWidth() const;
+
+    /**
+     * @brief Retrieves the height that decoded images are needed at.
+     * 
+     * @return The target height, or 0 if there is no limit on the height.
+     */
+    int32_t getTargetHeight() const;
+
     /**
      * @brief Decodes an image from a specified file path into an Image object.
      * 
@@ -41,4 +256,109 @@ public:
      * @return An Image object containing the decoded image data.
      */
     Image decodeImage(const std::string& filepath) const;
+
+    /**
+     * @brief Decodes an image from an encoded in-memory buffer into an Image object.
+     * 
+     * This method decodes the image directly from the given bytes (e.g., a PNG or JPEG file
+     * received over the network) without going through the file system. The returned Image
+     * owns its pixel data, just like the one returned by the file path version. The input
+     * buffer is not retained and can be freed once this method returns.
+     * 
+     * @param data The encoded image bytes.
+     * @return An Image object containing the decoded image data.
+     */
+    Image decodeImage(std::span<const uint8_t> data) const;
+
+    /**
+     * @brief Decodes an image pulled from a reader into an Image object.
+     * 
+     * The encoded bytes are consumed incrementally as the decoder needs them, so they never have
+     * to be stored in full, neither in memory nor on disk.
+     * 
+     * @param reader The reader that supplies the encoded image bytes.
+     * @return An Image object containing the decoded image data.
+     */
+    Image decodeImage(Reader& reader) const;
+
+    /**
+     * @brief Decodes an image file into a caller-provided buffer.
+     * 
+     * The pixels are written row by row into `destination`, `stride` bytes apart, with the channel count
+     * set by setChannels(), or the one stored in the file if none is set. The channels field of the
+     * returned properties reports the channel count written. With SampleDepth::Native, 16-bit and high
+     * dynamic range images are written as uint16_t and float samples, which the is16Bit and isHDR
+     * fields of the returned properties report. JPEG images reduced towards the target size report
+     * their reduced dimensions. The header is checked first, and if the image does not fit into the
+     * buffer an exception is thrown without touching it. Scratch memory used while decoding is
+     * recycled between calls on the same thread, so decoding similarly sized images repeatedly settles
+     * into a steady state without heap allocations (apart from those made by the C library to open the
+     * file).
+     * 
+     * @param filepath The file path of the image to decode.
+     * @param destination The buffer that receives the pixel data.
+     * @param stride Distance between the starts of consecutive rows in bytes. Zero means the rows are tightly packed.
+     * @return The properties of the decoded image.
+     */
+    Info decodeInto(const std::string& filepath, std::span<uint8_t> destination, size_t stride = 0) const;
+
+    /**
+     * @brief Decodes an encoded in-memory image into a caller-provided buffer.
+     * 
+     * @param data The encoded image bytes.
+     * @param destination The buffer that receives the pixel data.
+     * @param stride Distance between the starts of consecutive rows in bytes. Zero means the rows are tightly packed.
+     * @return The properties of the decoded image.
+     */
+    Info decodeInto(std::span<const uint8_t> data, std::span<uint8_t> destination, size_t stride = 0) const;
+
+    /**
+     * @brief Decodes an image pulled from a reader into a caller-provided buffer.
+     * 
+     * The header cannot be inspected ahead of the decode, so the size check happens after decoding;
+     * the buffer is still left untouched if the image doesn't fit. The returned properties report the
+     * dimensions, the channel count written and the is16Bit and isHDR fields, as for a file. The format
+     * is only filled in for JPEG images reduced towards the target size, and is Format::Unknown
+     * otherwise.
+     * 
+     * @param reader The reader that supplies the encoded image bytes.
+     * @param destination The buffer that receives the pixel data.
+     * @param stride Distance between the starts of consecutive rows in bytes. Zero means the rows are tightly packed.
+     * @return The properties of the decoded image.
+     */
+    Info decodeInto(Reader& reader, std::span<uint8_t> destination, size_t stride = 0) const;
+
+    /**
+     * @brief Reads the dimensions, channel count, bit depth and format of an image file without decoding it.
+     * 
+     * Only the header of the file is parsed and no pixel memory is allocated, which makes this
+     * suitable for rejecting oversized inputs before paying for a full decode.
+     * 
+     * @param filepath The file path of the image to probe.
+     * @return The properties of the image.
+     */
+    Info probe(const std::string& filepath) const;
+
+    /**
+     * @brief Reads the dimensions, channel count, bit depth and format of an encoded in-memory image
+     * without decoding it.
+     * 
+     * @param data The encoded image bytes.
+     * @return The properties of the image.
+     */
+    Info probe(std::span<const uint8_t> data) const;
+
+    /**
+     * @brief Decodes a batch of image files in parallel on a fixed-size pool of worker threads.
+     * 
+     * A failure to decode one file doesn't affect the others; it is reported in the corresponding
+     * result instead of being thrown. The files are always decoded on the pool's threads, even with a
+     * single worker, so the stb_image settings of the calling thread are left untouched.
+     * 
+     * @param filepaths The file paths of the images to decode.
+     * @param concurrency Number of worker threads. Zero uses one thread per hardware thread.
+     * @param progress Optional callback invoked after each item finishes.
+     * @return One result per file path, in the same order as the input.
+     */
+    std::vector<BatchResult> decodeBatch(std::span<const std::string> filepaths, size_t concurrency = 0, const ProgressCallback& progress = nullptr) const;
 };
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <string>
+#include <span>
+#include <vector>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 #include "image.h"
+#include "image-view.h"
 
 /**
  * @class ImageEncoder
@@ -25,9 +31,213 @@ public:
         PNG     = 0,
         JPEG    = 1
     };
+
+    /**
+     * @enum ChromaSubsampling
+     * @brief Chroma subsampling applied to color JPEG images.
+     */
+    enum class ChromaSubsampling: int32_t {
+        YUV444  = 0,    // Full chroma resolution.
+        YUV422  = 1,    // Half horizontal chroma resolution.
+        YUV420  = 2     // Half horizontal and vertical chroma resolution.
+    };
+
+    /**
+     * @enum DCTMethod
+     * @brief Forward DCT implementation used by the JPEG encoder.
+     */
+    enum class DCTMethod: int32_t {
+        ISLOW   = 0,    // Accurate integer DCT.
+        IFAST   = 1,    // Fast, less accurate integer DCT.
+        FLOAT   = 2     // Floating point DCT.
+    };
+
+    /**
+     * @enum AlphaMode
+     * @brief Handling of the alpha channel of gray-alpha and RGBA images by the JPEG encoder, since
+     * JPEG cannot store alpha.
+     */
+    enum class AlphaMode: int32_t {
+        Strip       = 0,    // Drop alpha and keep the color values as they are.
+        Composite   = 1     // Blend the pixels over the background color.
+    };
+
+    /**
+     * @struct JPEGOptions
+     * @brief Compression parameters for JPEG encoding. The defaults match libjpeg's defaults at quality 85.
+     */
+    struct JPEGOptions {
+        int32_t quality = 85;                                       // Quality from 0 to 100.
+        ChromaSubsampling subsampling = ChromaSubsampling::YUV420;  // Chroma subsampling for color images.
+        bool optimizeCoding = false;                                // Compute optimal Huffman tables (slower, smaller output).
+        bool progressive = false;                                   // Write a progressive JPEG.
+        DCTMethod dctMethod = DCTMethod::ISLOW;                     // Forward DCT implementation.
+        AlphaMode alphaMode = AlphaMode::Strip;                     // Handling of alpha in 2 and 4 channel images.
+        uint8_t background[3] = {255, 255, 255};                    // RGB color alpha is composited over. Gray images use its luma.
+    };
+
+    /**
+     * @enum CompressionStrategy
+     * @brief zlib compression strategy used by the PNG encoder.
+     */
+    enum class CompressionStrategy: int32_t {
+        Default     = 0,    // Let libpng choose based on the row filters in use.
+        Filtered    = 1,    // Z_FILTERED: tuned for filtered image data.
+        HuffmanOnly = 2,    // Z_HUFFMAN_ONLY: no string matching, entropy coding only.
+        RLE         = 3,    // Z_RLE: matches limited to runs of the previous byte.
+        Fixed       = 4     // Z_FIXED: no dynamic Huffman codes.
+    };
+
+    /**
+     * @brief Row filters for the PNG encoder, combined as a bit mask. libpng picks among the allowed
+     * filters for each row; allowing fewer filters is faster, allowing more usually compresses better.
+     */
+    struct RowFilter {
+        static constexpr uint32_t None      = 1u << 0;
+        static constexpr uint32_t Sub       = 1u << 1;
+        static constexpr uint32_t Up        = 1u << 2;
+        static constexpr uint32_t Average   = 1u << 3;
+        static constexpr uint32_t Paeth     = 1u << 4;
+        static constexpr uint32_t All       = None | Sub | Up | Average | Paeth;
+    };
+
+    /**
+     * @struct PNGOptions
+     * @brief Compression parameters for PNG encoding. The defaults match libpng's defaults.
+     */
+    struct PNGOptions {
+        int32_t compressionLevel = -1;                                  // zlib level from 0 to 9, or -1 for zlib's default (6).
+        CompressionStrategy strategy = CompressionStrategy::Default;    // zlib compression strategy.
+        uint32_t rowFilters = RowFilter::All;                           // Allowed row filters (RowFilter mask).
+        size_t bufferSize = 8192;                                       // Size of the zlib output buffer in bytes.
+
+        /**
+         * @brief Options trading compression ratio for speed: zlib level 1, no row filtering and RLE.
+         * Intended for short-lived intermediate files.
+         * 
+         * @return The fastest PNG options.
+         */
+        static PNGOptions fastest() {
+            PNGOptions options;
+            options.compressionLevel = 1;
+            options.strategy = CompressionStrategy::RLE;
+            options.rowFilters = RowFilter::None;
+            return options;
+        }
+
+        /**
+         * @brief Options trading speed for compression ratio: zlib level 9 and all row filters.
+         * Intended for cold storage.
+         * 
+         * @return The smallest-output PNG options.
+         */
+        static PNGOptions smallest() {
+            PNGOptions options;
+            options.compressionLevel = 9;
+            options.rowFilters = RowFilter::All;
+            return options;
+        }
+    };
+
+    /**
+     * @struct BatchResult
+     * @brief Outcome of encoding a single item of a batch.
+     */
+    struct BatchResult {
+        std::string error;      // Description of the failure. Empty if encoding succeeded.
+
+        /**
+         * @brief Checks whether the item was encoded successfully.
+         * 
+         * @return True if the item was encoded, false otherwise.
+         */
+        bool succeeded() const { return error.empty(); }
+    };
+
+    /**
+     * @brief Callback reporting batch progress as the number of finished items out of the total.
+     * Calls are serialized, but may happen on any of the worker threads.
+     */
+    using ProgressCallback = std::function<void(size_t completed, size_t total)>;
+
+    /**
+     * @class Stream
+     * @brief Encodes an image supplied a few rows at a time, so that images larger than the available
+     * memory can be produced strip by strip.
+     * 
+     * The image dimensions are declared with begin(), the rows are supplied from top to bottom with
+     * writeRows() and the encode is completed with finish(). The encoder's format and options at the
+     * time of begin() apply. If the stream is destroyed before finish() the encode is abandoned.
+     * Objects of this class are non-copyable.
+     */
+    class Stream {
+        struct State;
+        std::unique_ptr<State> m_state;
+
+    public:
+        /**
+         * @brief Constructs a stream that writes the encoded image to the specified file path.
+         * 
+         * @param encoder The encoder that determines the format and options. Must outlive the stream.
+         * @param filepath The file path where the encoded image will be saved.
+         */
+        Stream(const ImageEncoder& encoder, const std::string& filepath);
+
+        /**
+         * @brief Constructs a stream that writes the encoded image into an in-memory byte buffer.
+         * 
+         * @param encoder The encoder that determines the format and options. Must outlive the stream.
+         * @param output The vector that receives the encoded bytes. Must outlive the stream.
+         */
+        Stream(const ImageEncoder& encoder, std::vector<uint8_t>& output);
+
+        Stream(const Stream& other) = delete;
+        Stream& operator=(const Stream& other) = delete;
+
+        /**
+         * @brief Destructor that abandons an unfinished encode.
+         */
+        ~Stream();
+
+        /**
+         * @brief Starts encoding an image with the specified dimensions.
+         * 
+         * @param width Width of the image in pixels.
+         * @param height Height of the image in pixels.
+         * @param number_of_channels Number of channels in the image.
+         * @param sample_type Type of each channel sample. PNG stores 8-bit and 16-bit samples,
+         * JPEG only 8-bit samples; other types throw std::invalid_argument.
+         */
+        void begin(int32_t width, int32_t height, int32_t number_of_channels, Image::SampleType sample_type = Image::SampleType::U8);
+
+        /**
+         * @brief Encodes the next rows of the image.
+         * 
+         * @param rows Pointer to the first row to encode.
+         * @param count Number of rows to encode.
+         * @param stride Distance between the starts of consecutive rows in bytes. Zero means the rows are tightly packed.
+         * @throws std::invalid_argument If the stride is smaller than a row. The encode stays in progress then.
+         */
+        void writeRows(const uint8_t* rows, int32_t count, size_t stride = 0);
+
+        /**
+         * @brief Completes the encode. All rows of the image must have been written.
+         */
+        void finish();
+    };
     
 private:
-    Type m_type;    // Type of the encoder. Determines the format of the encoded image.
+    struct Context;
+    class ContextLease;
+
+    Type m_type;                    // Type of the encoder. Determines the format of the encoded image.
+    JPEGOptions m_jpeg_options;     // Compression parameters used by the JPEG encoder.
+    PNGOptions m_png_options;       // Compression parameters used by the PNG encoder.
+
+    // Idle compression contexts. Each concurrent encode leases one, so libpng/libjpeg state is set
+    // up once per thread of use and then reused for every subsequent image.
+    mutable std::vector<std::unique_ptr<Context>> m_contexts;
+    mutable std::mutex m_contexts_mutex;
 
 public:
 
@@ -53,6 +263,41 @@ public:
      * @param encoder_type Type of the encoder. Default is Type::PNG.
      */
     explicit ImageEncoder(Type encoder_type = Type::PNG);
+
+    /**
+     * @brief Destructor that releases the compression contexts.
+     */
+    ~ImageEncoder();
+
+    /**
+     * @brief Sets the compression parameters used for JPEG encoding. Must not be called while
+     * another thread is encoding with this object.
+     * 
+     * @param options The JPEG compression parameters.
+     */
+    void setJPEGOptions(const JPEGOptions& options);
+
+    /**
+     * @brief Retrieves the compression parameters used for JPEG encoding.
+     * 
+     * @return The JPEG compression parameters.
+     */
+    const JPEGOptions& getJPEGOptions() const;
+
+    /**
+     * @brief Sets the compression parameters used for PNG encoding. Must not be called while
+     * another thread is encoding with this object.
+     * 
+     * @param options The PNG compression parameters.
+     */
+    void setPNGOptions(const PNGOptions& options);
+
+    /**
+     * @brief Retrieves the compression parameters used for PNG encoding.
+     * 
+     * @return The PNG compression parameters.
+     */
+    const PNGOptions& getPNGOptions() const;
     
 
     /**
@@ -64,14 +309,87 @@ public:
      * @param height Height of the image in pixels.
      * @param number_of_channels Number of channels in the image (e.g.,1 for Grayscale, 2 for Grayscale with Alpha, 3 for RGB, 4 for RGB with Alpha, i.e., RGBA).
      * @param filepath The file path where the encoded image will be saved.
+     * @param stride Distance between the starts of consecutive rows in bytes, or zero for tightly packed rows.
      */
-    void encodeImage(const uint8_t* rgb_buffer, int32_t width, int32_t height, int32_t number_of_channels, const std::string& filepath) const;
+    void encodeImage(const uint8_t* rgb_buffer, int32_t width, int32_t height, int32_t number_of_channels, const std::string& filepath, size_t stride = 0) const;
     
     /**
-     * @brief Encodes an image from an Image object to the specified file path.
+     * @brief Encodes an image from an Image object to the specified file path. PNG stores 8-bit
+     * and 16-bit samples and JPEG only 8-bit samples; other sample types throw std::invalid_argument.
      * 
      * @param image The Image object to encode.
      * @param filepath The file path where the encoded image will be saved.
      */
     void encodeImage(const Image& image, const std::string& filepath) const;
+
+    /**
+     * @brief Encodes the pixels of a view, e.g., a crop of a larger image, to the specified file path.
+     * 
+     * @param view The view to encode.
+     * @param filepath The file path where the encoded image will be saved.
+     */
+    void encodeImage(const ImageView& view, const std::string& filepath) const;
+
+    /**
+     * @brief Encodes an image given a raw pixel buffer into an in-memory byte buffer.
+     * 
+     * The encoded bytes are written directly into `output`, which is grown geometrically as needed.
+     * Any previous contents of `output` are discarded, but its capacity is kept, so reusing the
+     * same vector across calls avoids reallocating once it has grown to a typical output size.
+     * 
+     * @param rgb_buffer Pointer to the raw pixel data buffer.
+     * @param width Width of the image in pixels.
+     * @param height Height of the image in pixels.
+     * @param number_of_channels Number of channels in the image.
+     * @param output The vector that receives the encoded bytes.
+     * @param stride Distance between the starts of consecutive rows in bytes, or zero for tightly packed rows.
+     */
+    void encodeToBuffer(const uint8_t* rgb_buffer, int32_t width, int32_t height, int32_t number_of_channels, std::vector<uint8_t>& output, size_t stride = 0) const;
+
+    /**
+     * @brief Encodes an image from an Image object into a reusable in-memory byte buffer.
+     * 
+     * @param image The Image object to encode.
+     * @param output The vector that receives the encoded bytes.
+     */
+    void encodeToBuffer(const Image& image, std::vector<uint8_t>& output) const;
+
+    /**
+     * @brief Encodes an image from an Image object into memory and returns the encoded bytes.
+     * 
+     * @param image The Image object to encode.
+     * @return The encoded image bytes.
+     */
+    std::vector<uint8_t> encodeToBuffer(const Image& image) const;
+
+    /**
+     * @brief Encodes the pixels of a view into a reusable in-memory byte buffer.
+     * 
+     * @param view The view to encode.
+     * @param output The vector that receives the encoded bytes.
+     */
+    void encodeToBuffer(const ImageView& view, std::vector<uint8_t>& output) const;
+
+    /**
+     * @brief Encodes the pixels of a view into memory and returns the encoded bytes.
+     * 
+     * @param view The view to encode.
+     * @return The encoded image bytes.
+     */
+    std::vector<uint8_t> encodeToBuffer(const ImageView& view) const;
+
+    /**
+     * @brief Encodes a batch of images to files in parallel on a fixed-size pool of worker threads.
+     * 
+     * Items are handed to the workers through a bounded queue, so at most a few encodes are pending
+     * at any time. A failure to encode one image doesn't stop the others; it is reported in the
+     * corresponding result instead of being thrown.
+     * 
+     * @param images The images to encode. Must have the same length as `filepaths`.
+     * @param filepaths The file paths where the encoded images will be saved.
+     * @param concurrency Number of worker threads. Zero uses one thread per hardware thread.
+     * @param progress Optional callback invoked after each item finishes.
+     * @return One result per image, in the same order as the input.
+     */
+    std::vector<BatchResult> encodeBatch(std::span<const Image* const> images, std::span<const std::string> filepaths, size_t concurrency = 0, const ProgressCallback& progress = nullptr) const;
 };
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "image.h"
+#include "image-allocator.h"
+
+/**
+ * @class ImagePool
+ * @brief The ImagePool class hands out images whose buffers return to the pool when the images are destroyed.
+ * 
+ * Workloads that cycle through a few image shapes, such as video frames or thumbnails, stop touching
+ * the allocator once the pool is warm, and recycled buffers have their pages faulted in already.
+ * Buffers are keyed by size in bytes, so any shapes of equal size share buffers. Images may outlive
+ * the pool and may be destroyed on any thread. Objects of this class are non-copyable.
+ */
+class ImagePool {
+    struct State;
+    State* m_state;     // Shared with the outstanding images; released by whoever lets go of it last.
+
+public:
+    /**
+     * @brief Constructs an empty pool.
+     * 
+     * @param max_idle_buffers Maximum number of idle buffers kept per buffer size. Buffers returned
+     * beyond that are deallocated.
+     * @param allocator Allocator the buffers come from. Null selects ImageAllocator::getDefault().
+     */
+    explicit ImagePool(size_t max_idle_buffers = 8, ImageAllocator* allocator = nullptr);
+
+    ImagePool(const ImagePool& other) = delete;
+    ImagePool& operator=(const ImagePool& other) = delete;
+
+    /**
+     * @brief Releases the idle buffers. Buffers of outstanding images are released when the images are destroyed.
+     */
+    ~ImagePool();
+
+    /**
+     * @brief Hands out an image with an uninitialized buffer, reusing an idle buffer of the same size if there is one.
+     * 
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param channels Number of channels in the image.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least width * channels.
+     * Zero means tightly packed rows.
+     * @return The image.
+     */
+    Image acquire(int32_t width, int32_t height, int32_t channels, size_t stride = 0);
+
+    /**
+     * @brief Allocates idle buffers for images of the specified shape up front and touches their memory,
+     * so that neither allocation nor page faults happen when the images are acquired.
+     * 
+     * @param width Width of the images.
+     * @param height Height of the images.
+     * @param channels Number of channels in the images.
+     * @param count Number of buffers to have idle, limited to the maximum number of idle buffers.
+     * @param stride Row stride of the images in bytes, or zero for tightly packed rows.
+     */
+    void reserve(int32_t width, int32_t height, int32_t channels, size_t count, size_t stride = 0);
+
+    /**
+     * @brief Deallocates all idle buffers. Buffers of outstanding images are only kept again for sizes
+     * acquired or reserved after this call, and are deallocated otherwise.
+     */
+    void trim();
+
+    /**
+     * @brief Retrieves the number of idle buffers across all sizes.
+     * 
+     * @return Number of idle buffers.
+     */
+    size_t getIdleCount() const;
+};
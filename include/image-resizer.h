@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+#include "image.h"
+#include "image-view.h"
+#include "image-allocator.h"
+
+class ThreadPool;
+
+/**
+ * @class ImageResizer
+ * @brief The ImageResizer class scales images with a separable resampling filter.
+ * 
+ * Each axis is filtered in its own pass, with the filter coefficients computed once per resize. The
+ * image is processed in strips of rows sized to stay in cache, which can be spread over worker
+ * threads. Images must have 8-bit samples and 1 to 4 channels; any row stride and crop is accepted.
+ * Results are within 1 of an exact floating point evaluation of the filter. Objects of this class
+ * are non-copyable.
+ */
+class ImageResizer {
+public:
+
+    /**
+     * @enum Filter
+     * @brief Specifies the resampling filter. When downscaling, filters are widened by the scale
+     * factor, so every source pixel contributes to the result.
+     */
+    enum class Filter: int32_t {
+        Box         = 0,    // Averages the pixels covered by each target pixel. Fastest, blocky when upscaling.
+        Bilinear    = 1,    // Triangle filter with a radius of 1 pixel.
+        Bicubic     = 2,    // Cubic convolution (a = -0.5) with a radius of 2 pixels. Slightly sharpening.
+        Lanczos3    = 3     // Windowed sinc with a radius of 3 pixels. Sharpest, best for thumbnails.
+    };
+
+private:
+    Filter m_filter;                    // Resampling filter.
+    size_t m_concurrency = 1;           // Number of threads working on each resize.
+    std::unique_ptr<ThreadPool> m_pool; // Worker threads, if the concurrency is above 1.
+
+public:
+
+    /**
+     * @brief Constructs a resizer that uses the specified filter on the calling thread.
+     * 
+     * @param filter The resampling filter.
+     */
+    explicit ImageResizer(Filter filter = Filter::Bicubic);
+
+    /**
+     * @brief Objects of ImageResizer class should not be copyable.
+     * 
+     * Copy constructor is deleted to prevent copying of resizer objects.
+     */
+    ImageResizer(const ImageResizer& other) = delete;
+
+    /**
+     * @brief Objects of ImageResizer class should not be copyable.
+     * 
+     * Copy assignment operator is deleted to prevent copying of resizer objects.
+     */
+    ImageResizer& operator=(const ImageResizer& other) = delete;
+
+    /**
+     * @brief Stops the worker threads, if any.
+     */
+    ~ImageResizer();
+
+    /**
+     * @brief Sets the resampling filter.
+     * 
+     * @param filter The resampling filter.
+     */
+    void setFilter(Filter filter);
+
+    /**
+     * @brief Retrieves the resampling filter.
+     * 
+     * @return The resampling filter.
+     */
+    Filter getFilter() const;
+
+    /**
+     * @brief Sets the number of threads working on each resize. Above 1, worker threads are started
+     * and kept until the concurrency changes or the resizer is destroyed. Not thread-safe with
+     * respect to concurrent resizes on this resizer.
+     * 
+     * @param concurrency Number of threads. Zero selects the number of hardware threads, and 1 resizes
+     * on the calling thread.
+     */
+    void setConcurrency(size_t concurrency);
+
+    /**
+     * @brief Retrieves the number of threads working on each resize.
+     * 
+     * @return Number of threads.
+     */
+    size_t getConcurrency() const;
+
+    /**
+     * @brief Scales an image to the specified dimensions.
+     * 
+     * @param source The image or view to scale.
+     * @param width Width of the scaled image.
+     * @param height Height of the scaled image.
+     * @param allocator Allocator for the scaled image. Null selects ImageAllocator::getDefault().
+     * @return The scaled image, with tightly packed rows and the channel count of the source.
+     * @throws std::invalid_argument If the source is empty or not supported, or a dimension is not positive.
+     */
+    Image resize(const ImageView& source, int32_t width, int32_t height, ImageAllocator* allocator = nullptr) const;
+
+    /**
+     * @brief Scales an image into a caller-provided buffer, e.g., an image handed out by an ImagePool.
+     * 
+     * @param source The image or view to scale.
+     * @param destination Buffer receiving the scaled pixels, with the channel count of the source.
+     * @param width Width of the scaled image.
+     * @param height Height of the scaled image.
+     * @param stride Distance between the starts of consecutive rows of the destination in bytes.
+     * Zero means the rows are tightly packed.
+     * @throws std::invalid_argument If the source is empty or not supported, or a dimension is not positive.
+     */
+    void resize(const ImageView& source, uint8_t* destination, int32_t width, int32_t height, size_t stride = 0) const;
+};
@@ -0,0 +1,131 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#include "image.h"
+
+/**
+ * @class ImageView
+ * @brief The ImageView class is a non-owning view of the pixels of an image or a rectangle within one.
+ * 
+ * A view is a pointer to the first pixel, the dimensions and the row stride, so it is cheap to copy
+ * and cropping is O(1): a crop refers to the same pixels with an offset pointer and the parent's
+ * stride. The viewed pixels must outlive the view. Use Image(const ImageView&) to make an owning copy.
+ */
+class ImageView {
+    const uint8_t* m_buffer;            // First pixel of the view.
+    int32_t m_width;                    // Width of the view in pixels.
+    int32_t m_height;                   // Height of the view in pixels.
+    int32_t m_channels;                 // Number of channels per pixel.
+    Image::SampleType m_sample_type;    // Type of each channel sample.
+    size_t m_stride;                    // Distance between the starts of consecutive rows in bytes.
+
+public:
+    /**
+     * @brief Default constructor that initializes an empty view.
+     */
+    ImageView();
+
+    /**
+     * @brief Constructs a view of a raw pixel buffer.
+     * 
+     * @param buffer Pointer to the first pixel.
+     * @param width Width of the view in pixels.
+     * @param height Height of the view in pixels.
+     * @param channels Number of channels per pixel.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least width * channels.
+     * Zero means tightly packed rows.
+     * @throws std::invalid_argument If the stride is smaller than a row.
+     */
+    ImageView(const uint8_t* buffer, int32_t width, int32_t height, int32_t channels, size_t stride = 0);
+
+    /**
+     * @brief Constructs a view of a raw buffer of samples of the specified type.
+     * 
+     * @param buffer Pointer to the first pixel.
+     * @param width Width of the view in pixels.
+     * @param height Height of the view in pixels.
+     * @param channels Number of channels per pixel.
+     * @param sample_type Type of each channel sample.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least the size of a row.
+     * Zero means tightly packed rows.
+     * @throws std::invalid_argument If the stride is smaller than a row.
+     */
+    ImageView(const uint8_t* buffer, int32_t width, int32_t height, int32_t channels, Image::SampleType sample_type, size_t stride = 0);
+
+    /**
+     * @brief Constructs a view of all pixels of an image.
+     * 
+     * @param image The image to view.
+     */
+    ImageView(const Image& image);
+
+    /**
+     * @brief Retrieves a view of a rectangle within this view, without copying any pixels.
+     * 
+     * @param x Left edge of the rectangle in pixels.
+     * @param y Top edge of the rectangle in pixels.
+     * @param width Width of the rectangle in pixels.
+     * @param height Height of the rectangle in pixels.
+     * @return View of the rectangle.
+     * @throws std::out_of_range If the rectangle doesn't lie within this view.
+     */
+    ImageView crop(int32_t x, int32_t y, int32_t width, int32_t height) const;
+
+    /**
+     * @brief Retrieves a pointer to the first pixel of the view.
+     * 
+     * @return Pointer to the first pixel.
+     */
+    const uint8_t* getBuffer() const;
+
+    /**
+     * @brief Retrieves a pointer to the first pixel of a row.
+     * 
+     * @param y Index of the row.
+     * @return Pointer to the first pixel of the row.
+     */
+    const uint8_t* getRow(int32_t y) const;
+
+    /**
+     * @brief Retrieves the span from the first byte of the first row to the last byte of the last row.
+     * 
+     * @return Size of the viewed buffer in bytes.
+     */
+    size_t getBufferSize() const;
+
+    /**
+     * @brief Retrieves the width of the view in pixels.
+     * 
+     * @return Width of the view in pixels.
+     */
+    int32_t getWidth() const;
+
+    /**
+     * @brief Retrieves the height of the view in pixels.
+     * 
+     * @return Height of the view in pixels.
+     */
+    int32_t getHeight() const;
+
+    /**
+     * @brief Retrieves the number of channels per pixel.
+     * 
+     * @return Number of channels per pixel.
+     */
+    int32_t getChannels() const;
+
+    /**
+     * @brief Retrieves the type of each channel sample.
+     * 
+     * @return The sample type.
+     */
+    Image::SampleType getSampleType() const;
+
+    /**
+     * @brief Retrieves the distance between the starts of consecutive rows in bytes.
+     * 
+     * @return Row stride in bytes.
+     */
+    size_t getStride() const;
+};
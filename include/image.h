@@ -1,7 +1,14 @@
 #pragma once
 #include <cstdint>
 #include <cstring>
-#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "image-allocator.h"
+
+class ImageView;
 
 /**
  * @class Image
@@ -12,11 +19,95 @@
  * It also supports custom deallocation functions for externally allocated buffers.
  */
 class Image {
+public:
+    /**
+     * @brief Function releasing a buffer, together with the context it was registered with.
+     */
+    using DeallocateFunction = void (*)(void* buffer, void* context);
+
+    /**
+     * @enum SampleType
+     * @brief Specifies the type of each channel sample. Samples are stored in host byte order.
+     */
+    enum class SampleType : uint8_t {
+        U8  = 0,    // 8-bit unsigned integer.
+        U16 = 1,    // 16-bit unsigned integer.
+        F32 = 2     // 32-bit floating point, nominally in [0, 1] for standard dynamic range data.
+    };
+
+    /**
+     * @enum LumaWeights
+     * @brief Specifies the weights of the red, green and blue channels when converting to grayscale.
+     */
+    enum class LumaWeights : uint8_t {
+        BT601 = 0,  // 0.299, 0.587, 0.114 (ITU-R BT.601, as used by JPEG).
+        BT709 = 1   // 0.2126, 0.7152, 0.0722 (ITU-R BT.709, as used by sRGB).
+    };
+
+private:
+    /**
+     * @brief How the buffer is released when the image is destroyed.
+     */
+    enum class Ownership : uint8_t {
+        Array,          // Released with delete[].
+        Allocator,      // Released through the ImageAllocator in m_context.
+        FreeFunction,   // Released by calling m_free.
+        Function,       // Released by calling m_deallocate with m_context.
+        Shared          // Shared with other images through the SharedBuffer in m_context.
+    };
+
+    /**
+     * @brief Reference counted owner of a buffer shared between images, holding its original ownership.
+     */
+    struct SharedBuffer;
+
     uint8_t* m_buffer;                          // Raw image pixel data.
     int32_t m_width;                            // Width of the image in pixels.
     int32_t m_height;                           // Height of the image in pixels.
     int32_t m_channels;                         // Number of channels (e.g., red, green, blue, and alpha).
-    std::function<void(void*)> m_deallocator;   // Custom deallocator function.
+    Ownership m_ownership;                      // How the buffer is released.
+    SampleType m_sample_type;                   // Type of each channel sample.
+    size_t m_stride;                            // Distance between the starts of consecutive rows in bytes.
+    DeallocateFunction m_deallocate;            // Deallocator for Ownership::Function.
+    union {
+        void* m_context;                        // Allocator or deallocator context.
+        void (*m_free)(void*);                  // Deallocator for Ownership::FreeFunction.
+    };
+
+    /**
+     * @brief Releases the buffer according to the ownership.
+     */
+    void release() noexcept;
+
+    /**
+     * @brief Retrieves the number of bytes allocated for the buffer by the image itself.
+     */
+    size_t getAllocationSize() const;
+
+    /**
+     * @brief Retrieves the allocator that copies of the buffer are allocated from.
+     */
+    ImageAllocator& getCopyAllocator() const;
+
+    /**
+     * @brief Allocates the buffer from an allocator.
+     */
+    void allocate(ImageAllocator& allocator);
+
+    /**
+     * @brief Allocates the buffer from an allocator and copies the rows of another buffer into it.
+     */
+    void allocateCopy(const uint8_t* buffer, size_t stride, ImageAllocator& allocator);
+
+    /**
+     * @brief Invokes and destroys a heap-held stateful deallocator.
+     */
+    template <typename Deallocator>
+    static void invokeHeldDeallocator(void* buffer, void* context) {
+        auto* deallocator = static_cast<Deallocator*>(context);
+        (*deallocator)(buffer);
+        delete deallocator;
+    }
 
 public:
     /**
@@ -32,24 +123,184 @@ public:
      * @param width Width of the image.
      * @param height Height of the image.
      * @param channels Number of channels in the image.
+     * @param allocator Allocator for the image's own copy of the buffer. Null selects ImageAllocator::getDefault().
+     * Copies of the image allocate from the same allocator.
      */
-    Image(const uint8_t* buffer, int32_t width, int32_t height, int32_t channels);
+    Image(const uint8_t* buffer, int32_t width, int32_t height, int32_t channels, ImageAllocator* allocator = nullptr);
+
+    /**
+     * @brief Constructs an image with an uninitialized buffer of the specified dimensions, to be
+     * filled through getMutableBuffer(). Pass alignedStride() as the stride to start every row on
+     * an ImageAllocator::ALIGNMENT boundary.
+     * 
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param channels Number of channels in the image.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least width * channels.
+     * Zero means tightly packed rows.
+     * @param allocator Allocator for the buffer. Null selects ImageAllocator::getDefault().
+     * @throws std::invalid_argument If the stride is smaller than a row.
+     */
+    Image(int32_t width, int32_t height, int32_t channels, size_t stride = 0, ImageAllocator* allocator = nullptr);
+
+    /**
+     * @brief Constructs an image with an uninitialized buffer of the specified dimensions and sample type.
+     * 
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param channels Number of channels in the image.
+     * @param sample_type Type of each channel sample.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least the size of a row.
+     * Zero means tightly packed rows.
+     * @param allocator Allocator for the buffer. Null selects ImageAllocator::getDefault().
+     * @throws std::invalid_argument If the stride is smaller than a row.
+     */
+    Image(int32_t width, int32_t height, int32_t channels, SampleType sample_type, size_t stride = 0, ImageAllocator* allocator = nullptr);
+
+    /**
+     * @brief Constructs an image with a tightly packed copy of the pixels of a view, e.g., a crop.
+     * 
+     * @param view The view to copy from.
+     * @param allocator Allocator for the image's buffer. Null selects ImageAllocator::getDefault().
+     */
+    explicit Image(const ImageView& view, ImageAllocator* allocator = nullptr);
 
     /**
      * @brief Constructs an image with a specified buffer and deallocator. The object
      * takes the ownership of the buffer memory upon construction, i.e., the caller
      * shouldn't free the external buffer after calling the constructor.
      * 
+     * Plain functions and captureless lambdas are stored as a function pointer. Any other
+     * callable is moved to the heap; prefer the function and context overload on hot paths.
+     * A null deallocator releases the buffer with delete[].
+     * 
+     * @param buffer Pointer to the image data buffer.
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param channels Number of channels in the image.
+     * @param deallocator Callable invoked with the buffer to deallocate the buffer memory.
+     */
+    template <typename Deallocator>
+        requires std::is_invocable_v<Deallocator&, void*> || std::is_null_pointer_v<Deallocator>
+    Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, Deallocator deallocator)
+        : Image(buffer, width, height, channels, 0, std::move(deallocator)) {}
+
+    /**
+     * @brief Constructs an image with a specified buffer with padded rows and a deallocator. The
+     * object takes the ownership of the buffer memory upon construction, as with the constructor above.
+     * 
+     * @param buffer Pointer to the image data buffer.
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param channels Number of channels in the image.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least width * channels.
+     * Zero means tightly packed rows.
+     * @param deallocator Callable invoked with the buffer to deallocate the buffer memory.
+     * @throws std::invalid_argument If the stride is smaller than a row. The buffer is not taken over then.
+     */
+    template <typename Deallocator>
+        requires std::is_invocable_v<Deallocator&, void*> || std::is_null_pointer_v<Deallocator>
+    Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, size_t stride, Deallocator deallocator)
+        : Image(buffer, width, height, channels, SampleType::U8, stride, std::move(deallocator)) {}
+
+    /**
+     * @brief Constructs an image with a specified buffer of samples of the specified type and a
+     * deallocator. The object takes the ownership of the buffer memory upon construction.
+     * 
+     * @param buffer Pointer to the image data buffer.
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param channels Number of channels in the image.
+     * @param sample_type Type of each channel sample.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least the size of a row.
+     * Zero means tightly packed rows.
+     * @param deallocator Callable invoked with the buffer to deallocate the buffer memory.
+     * @throws std::invalid_argument If the stride is smaller than a row. The buffer is not taken over then.
+     */
+    template <typename Deallocator>
+        requires std::is_invocable_v<Deallocator&, void*> || std::is_null_pointer_v<Deallocator>
+    Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, SampleType sample_type, size_t stride, Deallocator deallocator)
+        : m_buffer(buffer), m_width(width), m_height(height), m_channels(channels), m_ownership(Ownership::Array), m_sample_type(sample_type),
+          m_stride(packedStride(width, channels, sample_type, stride)), m_deallocate(nullptr), m_context(nullptr) {
+        if constexpr (std::is_null_pointer_v<Deallocator>) {
+            return;
+        } else if constexpr (std::is_convertible_v<Deallocator, void (*)(void*)>) {
+            void (*free)(void*) = deallocator;
+            if (free) {
+                m_ownership = Ownership::FreeFunction;
+                m_free = free;
+            }
+        } else {
+            if constexpr (std::is_constructible_v<bool, const Deallocator&>) {
+                if (! static_cast<bool>(deallocator)) {
+                    return;
+                }
+            }
+            Deallocator* held;
+            try {
+                held = new Deallocator(std::move(deallocator));
+            } catch (...) {
+                // The image owns the buffer from here on, so don't leak it on failure.
+                deallocator(buffer);
+                throw;
+            }
+            m_ownership = Ownership::Function;
+            m_deallocate = &invokeHeldDeallocator<Deallocator>;
+            m_context = held;
+        }
+    }
+
+    /**
+     * @brief Constructs an image with a specified buffer, deallocator function and context.
+     * The object takes the ownership of the buffer memory upon construction.
+     * 
      * @param buffer Pointer to the image data buffer.
      * @param width Width of the image.
      * @param height Height of the image.
      * @param channels Number of channels in the image.
-     * @param deallocator Function to deallocate the buffer memory.
+     * @param deallocate Function invoked with the buffer and the context to deallocate the buffer memory.
+     * @param context Context passed to the deallocator.
      */
-    Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, std::function<void(void*)> deallocator);
+    Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, DeallocateFunction deallocate, void* context);
 
     /**
-     * @brief Copy constructor that performs a deep copy of the image.
+     * @brief Constructs an image with a specified buffer with padded rows, deallocator function and
+     * context. The object takes the ownership of the buffer memory upon construction.
+     * 
+     * @param buffer Pointer to the image data buffer.
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param channels Number of channels in the image.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least width * channels.
+     * Zero means tightly packed rows.
+     * @param deallocate Function invoked with the buffer and the context to deallocate the buffer memory.
+     * @param context Context passed to the deallocator.
+     * @throws std::invalid_argument If the stride is smaller than a row. The buffer is not taken over then.
+     */
+    Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, size_t stride, DeallocateFunction deallocate, void* context);
+
+    /**
+     * @brief Constructs an image with a specified buffer of samples of the specified type, deallocator
+     * function and context. The object takes the ownership of the buffer memory upon construction.
+     * 
+     * @param buffer Pointer to the image data buffer.
+     * @param width Width of the image.
+     * @param height Height of the image.
+     * @param channels Number of channels in the image.
+     * @param sample_type Type of each channel sample.
+     * @param stride Distance between the starts of consecutive rows in bytes, at least the size of a row.
+     * Zero means tightly packed rows.
+     * @param deallocate Function invoked with the buffer and the context to deallocate the buffer memory.
+     * @param context Context passed to the deallocator.
+     * @throws std::invalid_argument If the stride is smaller than a row. The buffer is not taken over then.
+     */
+    Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, SampleType sample_type, size_t stride, DeallocateFunction deallocate, void* context);
+
+    /**
+     * @brief Copy constructor that performs a deep copy of the image. The copy allocates from the
+     * other image's allocator, or from the default allocator if the other image doesn't have one.
+     * Its rows are tightly packed, whatever the stride of the other image. If the other image is
+     * shared (see makeShared()), the copy shares its buffer instead, which takes constant time.
      * 
      * @param other The other image to copy from.
      */
@@ -63,7 +314,8 @@ public:
     Image(Image&& other) noexcept;
 
     /**
-     * @brief Copy assignment operator that performs a deep copy of the image.
+     * @brief Copy assignment operator that performs a deep copy of the image, or shares the
+     * buffer of a shared image, as the copy constructor does.
      * 
      * @param other The other image to copy from.
      * @return Reference to the assigned image.
@@ -88,12 +340,75 @@ public:
     const uint8_t* getBuffer() const;
 
     /**
-     * @brief Retrieves the size of the buffer containing image data in bytes.
+     * @brief Retrieves the image data buffer for writing. Calling this function doesn't
+     * transfer ownership to the caller. If the buffer is shared with other images, the image
+     * first detaches from them by copying the buffer (copy-on-write), so the others are unaffected.
+     * 
+     * @return Pointer to the image data buffer.
+     */
+    uint8_t* getMutableBuffer();
+
+    /**
+     * @brief Switches the image to shared mode, in which copies share the buffer through a
+     * thread-safe reference count instead of copying the pixels, until one of them calls
+     * getMutableBuffer(). Concurrent copies of a shared image are safe. Does nothing for
+     * empty or already shared images.
+     */
+    void makeShared();
+
+    /**
+     * @brief Checks whether the image is in shared mode.
+     * 
+     * @return True if copies of the image share its buffer, false otherwise.
+     */
+    bool isShared() const;
+
+    /**
+     * @brief Retrieves the size of the buffer containing image data in bytes, i.e., the span
+     * from the first byte of the first row to the last byte of the last row.
      * 
      * @return Size of the image buffer in bytes.
      */
     size_t getBufferSize() const;
 
+    /**
+     * @brief Retrieves the distance between the starts of consecutive rows in bytes.
+     * Equals width * channels for tightly packed rows.
+     * 
+     * @return Row stride in bytes.
+     */
+    size_t getStride() const;
+
+    /**
+     * @brief Computes the smallest stride of at least the size of a row that keeps every row
+     * aligned to ImageAllocator::ALIGNMENT.
+     * 
+     * @param width Width of the image in pixels.
+     * @param channels Number of channels in the image.
+     * @param sample_type Type of each channel sample.
+     * @return Aligned row stride in bytes.
+     */
+    static size_t alignedStride(int32_t width, int32_t channels, SampleType sample_type = SampleType::U8);
+
+    /**
+     * @brief Resolves a row stride, where zero means tightly packed rows. Every constructor taking a
+     * stride, of images and of views, goes through here, so rows never overlap.
+     * 
+     * @param width Width of the image in pixels.
+     * @param channels Number of channels in the image.
+     * @param sample_type Type of each channel sample.
+     * @param stride Distance between the starts of consecutive rows in bytes, or zero for tightly packed rows.
+     * @return Row stride in bytes.
+     * @throws std::invalid_argument If the stride is smaller than a row.
+     */
+    static size_t packedStride(int32_t width, int32_t channels, SampleType sample_type, size_t stride) {
+        size_t row_size = static_cast<size_t>(width) * channels * getSampleSize(sample_type);
+        if (stride != 0 && stride < row_size) {
+            throw std::invalid_argument("Image row stride must be at least the size of a row");
+        }
+        return stride ? stride : row_size;
+    }
+
     /**
      * @brief Retrieves the width of the image in pixels.
      * 
@@ -115,6 +430,72 @@ public:
      */
     int32_t getChannels() const;
 
+    /**
+     * @brief Retrieves the type of each channel sample.
+     * 
+     * @return The sample type.
+     */
+    SampleType getSampleType() const;
+
+    /**
+     * @brief Retrieves the size of a sample of the specified type in bytes.
+     * 
+     * @param sample_type The sample type.
+     * @return Size of a sample in bytes.
+     */
+    static size_t getSampleSize(SampleType sample_type) {
+        switch (sample_type) {
+            case SampleType::U16:
+                return 2;
+            case SampleType::F32:
+                return 4;
+            default:
+                return 1;
+        }
+    }
+
+    /**
+     * @brief Converts the image to RGBA. Gray is replicated into the color channels, and images
+     * without alpha become fully opaque.
+     * 
+     * Like the other channel conversions, this requires 8-bit samples and 1 (gray), 2 (gray and
+     * alpha), 3 (RGB) or 4 (RGBA) channels, and returns an image with tightly packed rows. The rows
+     * are converted with the widest SIMD instructions the CPU supports.
+     * 
+     * @param allocator Allocator for the converted image. Null selects the allocator copies of this image use.
+     * @return The converted image.
+     * @throws std::invalid_argument If the sample type or channel count is not supported.
+     */
+    Image toRGBA(ImageAllocator* allocator = nullptr) const;
+
+    /**
+     * @brief Converts the image to RGB, dropping alpha.
+     * 
+     * @param allocator Allocator for the converted image. Null selects the allocator copies of this image use.
+     * @return The converted image.
+     * @throws std::invalid_argument If the sample type or channel count is not supported.
+     */
+    Image toRGB(ImageAllocator* allocator = nullptr) const;
+
+    /**
+     * @brief Converts the image to BGRA, the byte order of most GPU and windowing system surfaces.
+     * 
+     * @param allocator Allocator for the converted image. Null selects the allocator copies of this image use.
+     * @return The converted image.
+     * @throws std::invalid_argument If the sample type or channel count is not supported.
+     */
+    Image toBGRA(ImageAllocator* allocator = nullptr) const;
+
+    /**
+     * @brief Converts the image to grayscale, dropping alpha.
+     * 
+     * @param weights Weights of the color channels.
+     * @param allocator Allocator for the converted image. Null selects the allocator copies of this image use.
+     * @return The converted image.
+     * @throws std::invalid_argument If the sample type or channel count is not supported.
+     */
+    Image toGray(LumaWeights weights = LumaWeights::BT601, ImageAllocator* allocator = nullptr) const;
+
     /**
      * @brief Destructor that releases the allocated buffer memory.
      */
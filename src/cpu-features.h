@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMAGE_HAS_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define IMAGE_HAS_X86_SIMD 0
+#endif
+
+/**
+ * @enum CpuTier
+ * @brief Instruction set tiers that SIMD kernels are written for, from the narrowest to the widest.
+ * Each tier implies support for the ones below it.
+ */
+enum class CpuTier: int32_t {
+    Scalar  = 0,    // Portable C++ only.
+    SSSE3   = 1,    // 128-bit integer vectors with byte shuffles.
+    AVX2    = 2     // 256-bit integer vectors.
+};
+
+/**
+ * @brief Detects the widest instruction set tier the CPU supports.
+ */
+inline CpuTier detectCpuTier() {
+#if IMAGE_HAS_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return CpuTier::AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return CpuTier::SSSE3;
+    }
+#endif
+    return CpuTier::Scalar;
+}
+
+/**
+ * @brief Retrieves the widest instruction set tier the CPU supports, detected on first use.
+ */
+inline CpuTier getCpuTier() {
+    static const CpuTier tier = detectCpuTier();
+    return tier;
+}
+
+/**
+ * @brief Checks whether the CPU can run kernels of the specified tier.
+ */
+inline bool isCpuTierSupported(CpuTier tier) {
+    return tier <= getCpuTier();
+}
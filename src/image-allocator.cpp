@@ -0,0 +1,108 @@
+#include <cstdlib>
+
+#include "image-allocator.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define IMAGE_HAS_MMAP 1
+#include <sys/mman.h>
+#else
+#define IMAGE_HAS_MMAP 0
+#endif
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Size of the pages that large blocks are aligned to, so that the kernel can back them with huge pages.
+ */
+constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+/**
+ * @brief Rounds a size up to a multiple of a power of two.
+ */
+constexpr size_t roundUp(size_t size, size_t multiple) {
+    return (size + multiple - 1) & ~(multiple - 1);
+}
+
+/**
+ * @brief Default allocator. Blocks are aligned to ImageAllocator::ALIGNMENT; blocks of at least
+ * ImageAllocator::HUGE_PAGE_THRESHOLD bytes are mapped directly and advised for transparent huge pages.
+ */
+class DefaultAllocator : public ImageAllocator {
+public:
+    void* allocate(size_t size) override {
+#if IMAGE_HAS_MMAP
+        if (size >= HUGE_PAGE_THRESHOLD) {
+            return mapHugePages(size);
+        }
+#endif
+        size = roundUp(size ? size : 1, ALIGNMENT);
+#if defined(_WIN32)
+        return _aligned_malloc(size, ALIGNMENT);
+#else
+        return std::aligned_alloc(ALIGNMENT, size);
+#endif
+    }
+
+    void deallocate(void* pointer, size_t size) override {
+        if (! pointer) {
+            return;
+        }
+#if IMAGE_HAS_MMAP
+        if (size >= HUGE_PAGE_THRESHOLD) {
+            munmap(pointer, roundUp(size, HUGE_PAGE_SIZE));
+            return;
+        }
+#endif
+#if defined(_WIN32)
+        _aligned_free(pointer);
+#else
+        std::free(pointer);
+#endif
+    }
+
+private:
+#if IMAGE_HAS_MMAP
+    /**
+     * @brief Maps a huge page aligned block. The mapping is over-allocated by one huge page and trimmed,
+     * since mmap only guarantees regular page alignment.
+     */
+    static void* mapHugePages(size_t size) {
+        size_t length = roundUp(size, HUGE_PAGE_SIZE);
+        void* mapping = mmap(nullptr, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            return nullptr;
+        }
+
+        uint8_t* start = static_cast<uint8_t*>(mapping);
+        uint8_t* aligned = reinterpret_cast<uint8_t*>(roundUp(reinterpret_cast<uintptr_t>(start), HUGE_PAGE_SIZE));
+        if (aligned > start) {
+            munmap(start, aligned - start);
+        }
+        uint8_t* end = start + length + HUGE_PAGE_SIZE;
+        if (end > aligned + length) {
+            munmap(aligned + length, end - (aligned + length));
+        }
+
+#ifdef MADV_HUGEPAGE
+        // Only a hint; without transparent huge page support the block is simply backed by regular pages.
+        madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+        return aligned;
+    }
+#endif
+};
+
+} // namespace
+
+/**
+ * @brief Retrieves the allocator used when none is specified.
+ */
+ImageAllocator& ImageAllocator::getDefault() {
+    // Never destroyed, so images released during static destruction can still use it.
+    static DefaultAllocator& allocator = *new DefaultAllocator();
+    return allocator;
+}
@@ -0,0 +1,497 @@
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "cpu-features.h"
+#include "image.h"
+#include "image-view.h"
+
+namespace {
+
+/**
+ * @brief Converts a row of `width` pixels from one channel layout to another.
+ */
+using RowKernel = void (*)(const uint8_t* source, uint8_t* destination, int32_t width);
+
+/**
+ * @brief Converts a row of `width` pixels to grayscale, weighting red, green and blue by the
+ * first three of `weights`, in units of 2^-LUMA_SHIFT.
+ */
+using LumaKernel = void (*)(const uint8_t* source, uint8_t* destination, int32_t width, const int16_t* weights);
+
+/**
+ * @brief Fixed-point precision of the luma weights. Each set of weights sums to 1 << LUMA_SHIFT,
+ * so white stays white.
+ */
+constexpr int LUMA_SHIFT = 14;
+constexpr int32_t LUMA_ROUNDING = 1 << (LUMA_SHIFT - 1);
+
+constexpr int16_t BT601_WEIGHTS[3] = {4899, 9617, 1868};    // 0.299, 0.587, 0.114
+constexpr int16_t BT709_WEIGHTS[3] = {3483, 11718, 1183};   // 0.2126, 0.7152, 0.0722
+
+// Scalar kernels. These are the reference for the SIMD kernels, which produce identical results,
+// and convert the pixels at the end of a row that don't fill a whole vector.
+
+void rgbToRGBA(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 3, destination += 4) {
+        destination[0] = source[0];
+        destination[1] = source[1];
+        destination[2] = source[2];
+        destination[3] = 255;
+    }
+}
+
+void rgbToBGRA(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 3, destination += 4) {
+        destination[0] = source[2];
+        destination[1] = source[1];
+        destination[2] = source[0];
+        destination[3] = 255;
+    }
+}
+
+void rgbaToRGB(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 4, destination += 3) {
+        destination[0] = source[0];
+        destination[1] = source[1];
+        destination[2] = source[2];
+    }
+}
+
+void rgbaToBGRA(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 4, destination += 4) {
+        destination[0] = source[2];
+        destination[1] = source[1];
+        destination[2] = source[0];
+        destination[3] = source[3];
+    }
+}
+
+void grayToRGBA(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 1, destination += 4) {
+        destination[0] = destination[1] = destination[2] = source[0];
+        destination[3] = 255;
+    }
+}
+
+void grayAlphaToRGBA(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 2, destination += 4) {
+        destination[0] = destination[1] = destination[2] = source[0];
+        destination[3] = source[1];
+    }
+}
+
+void grayToRGB(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 1, destination += 3) {
+        destination[0] = destination[1] = destination[2] = source[0];
+    }
+}
+
+void grayAlphaToRGB(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 2, destination += 3) {
+        destination[0] = destination[1] = destination[2] = source[0];
+    }
+}
+
+void grayAlphaToGray(const uint8_t* source, uint8_t* destination, int32_t width) {
+    for (int32_t x = 0; x < width; x++, source += 2, destination += 1) {
+        destination[0] = source[0];
+    }
+}
+
+template <int Channels>
+void colorToGray(const uint8_t* source, uint8_t* destination, int32_t width, const int16_t* weights) {
+    for (int32_t x = 0; x < width; x++, source += Channels) {
+        int32_t luma = source[0] * weights[0] + source[1] * weights[1] + source[2] * weights[2];
+        destination[x] = static_cast<uint8_t>((luma + LUMA_ROUNDING) >> LUMA_SHIFT);
+    }
+}
+
+#if IMAGE_HAS_X86_SIMD
+
+// SSSE3 kernels. Byte shuffles (pshufb) are what make these conversions vectorizable, so SSSE3
+// rather than baseline SSE2 is the lowest tier. Loads and stores are unaligned, since rows of
+// strided images and crops start anywhere.
+
+/**
+ * @brief Shuffle spreading four packed RGB pixels to four 32-bit pixels, with red and blue swapped
+ * if `Swap` is set. The fourth byte of each pixel is zeroed.
+ */
+template <bool Swap>
+__attribute__((target("ssse3"))) __m128i rgbSpreadShuffle() {
+    return Swap ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+}
+
+template <bool Swap>
+__attribute__((target("ssse3"))) void rgbToFourChannelsSSSE3(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m128i shuffle = rgbSpreadShuffle<Swap>();
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    int32_t x = 0;
+    // Each load reads 16 bytes but consumes 12, so stop while a whole load still fits in the row.
+    for (; x + 6 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 3));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+    }
+    (Swap ? rgbToBGRA : rgbToRGBA)(source + x * 3, destination + x * 4, width - x);
+}
+
+__attribute__((target("ssse3"))) void rgbaToRGBSSSE3(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    int32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const auto* input = reinterpret_cast<const __m128i*>(source + x * 4);
+        __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(input + 0), shuffle);
+        __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(input + 1), shuffle);
+        __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(input + 2), shuffle);
+        __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(input + 3), shuffle);
+        // Stitch the four 12-byte groups into three full vectors.
+        auto* output = reinterpret_cast<__m128i*>(destination + x * 3);
+        _mm_storeu_si128(output + 0, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+        _mm_storeu_si128(output + 1, _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+        _mm_storeu_si128(output + 2, _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+    }
+    rgbaToRGB(source + x * 4, destination + x * 3, width - x);
+}
+
+__attribute__((target("ssse3"))) void rgbaToBGRASSSE3(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int32_t x = 0;
+    for (; x + 4 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4), _mm_shuffle_epi8(pixels, shuffle));
+    }
+    rgbaToBGRA(source + x * 4, destination + x * 4, width - x);
+}
+
+__attribute__((target("ssse3"))) void grayToRGBASSSE3(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, -128, 1, 1, 1, -128, 2, 2, 2, -128, 3, 3, 3, -128);
+    const __m128i step = _mm_set1_epi8(4);
+    int32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x));
+        auto* output = reinterpret_cast<__m128i*>(destination + x * 4);
+        // Adding to the shuffle keeps the -128 entries negative, so they still produce zeros.
+        __m128i shuffle = spread;
+        for (int i = 0; i < 4; i++, shuffle = _mm_add_epi8(shuffle, step)) {
+            _mm_storeu_si128(output + i, _mm_or_si128(_mm_shuffle_epi8(gray, shuffle), alpha));
+        }
+    }
+    grayToRGBA(source + x, destination + x * 4, width - x);
+}
+
+__attribute__((target("ssse3"))) void grayAlphaToRGBASSSE3(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m128i low = _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+    const __m128i high = _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15);
+    int32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x * 2));
+        auto* output = reinterpret_cast<__m128i*>(destination + x * 4);
+        _mm_storeu_si128(output + 0, _mm_shuffle_epi8(pixels, low));
+        _mm_storeu_si128(output + 1, _mm_shuffle_epi8(pixels, high));
+    }
+    grayAlphaToRGBA(source + x * 2, destination + x * 4, width - x);
+}
+
+/**
+ * @brief Computes the unscaled lumas of four 32-bit pixels, whose fourth byte is ignored.
+ */
+__attribute__((target("ssse3"))) __m128i lumaSSSE3(__m128i pixels, __m128i weights) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i low = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+    __m128i high = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+    return _mm_hadd_epi32(low, high);
+}
+
+template <int Channels>
+__attribute__((target("ssse3"))) void colorToGraySSSE3(const uint8_t* source, uint8_t* destination, int32_t width, const int16_t* weights) {
+    const __m128i factors = _mm_setr_epi16(weights[0], weights[1], weights[2], 0, weights[0], weights[1], weights[2], 0);
+    const __m128i rounding = _mm_set1_epi32(LUMA_ROUNDING);
+    const __m128i spread = rgbSpreadShuffle<false>();
+    int32_t x = 0;
+    // RGB loads read 4 bytes past the 24 they consume.
+    for (; x + (Channels == 3 ? 10 : 8) <= width; x += 8) {
+        const uint8_t* input = source + x * Channels;
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 4 * Channels));
+        if constexpr (Channels == 3) {
+            first = _mm_shuffle_epi8(first, spread);
+            second = _mm_shuffle_epi8(second, spread);
+        }
+        first = _mm_srli_epi32(_mm_add_epi32(lumaSSSE3(first, factors), rounding), LUMA_SHIFT);
+        second = _mm_srli_epi32(_mm_add_epi32(lumaSSSE3(second, factors), rounding), LUMA_SHIFT);
+        __m128i words = _mm_packs_epi32(first, second);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + x), _mm_packus_epi16(words, words));
+    }
+    colorToGray<Channels>(source + x * Channels, destination + x, width - x, weights);
+}
+
+// AVX2 kernels. Byte shuffles operate within each 128-bit lane, so the 256-bit kernels arrange
+// their data per lane and fix up the order across lanes where needed.
+
+/**
+ * @brief Loads two groups of 16 bytes, `offset` bytes apart, into the two lanes of a vector.
+ */
+__attribute__((target("avx2"))) __m256i loadLanesAVX2(const uint8_t* source, size_t offset) {
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + offset));
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+}
+
+template <bool Swap>
+__attribute__((target("avx2"))) void rgbToFourChannelsAVX2(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m256i shuffle = _mm256_broadcastsi128_si256(rgbSpreadShuffle<Swap>());
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    int32_t x = 0;
+    for (; x + 10 <= width; x += 8) {
+        __m256i pixels = loadLanesAVX2(source + x * 3, 12);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x * 4), _mm256_or_si256(_mm256_shuffle_epi8(pixels, shuffle), alpha));
+    }
+    (Swap ? rgbToBGRA : rgbToRGBA)(source + x * 3, destination + x * 4, width - x);
+}
+
+__attribute__((target("avx2"))) void rgbaToRGBAVX2(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                             0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    // Moves the 12 bytes packed into each lane next to each other.
+    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    int32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x * 4));
+        __m256i packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(pixels, shuffle), compact);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 3), _mm256_castsi256_si128(packed));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination + x * 3 + 16), _mm256_extracti128_si256(packed, 1));
+    }
+    rgbaToRGB(source + x * 4, destination + x * 3, width - x);
+}
+
+__attribute__((target("avx2"))) void rgbaToBGRAAVX2(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    int32_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + x * 4), _mm256_shuffle_epi8(pixels, shuffle));
+    }
+    rgbaToBGRA(source + x * 4, destination + x * 4, width - x);
+}
+
+__attribute__((target("avx2"))) void grayToRGBAAVX2(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+    const __m256i first = _mm256_setr_epi8(0, 0, 0, -128, 1, 1, 1, -128, 2, 2, 2, -128, 3, 3, 3, -128,
+                                           4, 4, 4, -128, 5, 5, 5, -128, 6, 6, 6, -128, 7, 7, 7, -128);
+    const __m256i second = _mm256_add_epi8(first, _mm256_set1_epi8(8));
+    int32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        // Both lanes hold all 16 gray values, so each lane can pick any of them.
+        __m256i gray = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + x)));
+        auto* output = reinterpret_cast<__m256i*>(destination + x * 4);
+        _mm256_storeu_si256(output + 0, _mm256_or_si256(_mm256_shuffle_epi8(gray, first), alpha));
+        _mm256_storeu_si256(output + 1, _mm256_or_si256(_mm256_shuffle_epi8(gray, second), alpha));
+    }
+    grayToRGBA(source + x, destination + x * 4, width - x);
+}
+
+__attribute__((target("avx2"))) void grayAlphaToRGBAAVX2(const uint8_t* source, uint8_t* destination, int32_t width) {
+    const __m256i low = _mm256_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7,
+                                         0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+    const __m256i high = _mm256_add_epi8(low, _mm256_set1_epi8(8));
+    int32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + x * 2));
+        // Each lane expands its own eight pixels; reorder the halves into pixels 0-7 and 8-15.
+        __m256i a = _mm256_shuffle_epi8(pixels, low);
+        __m256i b = _mm256_shuffle_epi8(pixels, high);
+        auto* output = reinterpret_cast<__m256i*>(destination + x * 4);
+        _mm256_storeu_si256(output + 0, _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(output + 1, _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    grayAlphaToRGBA(source + x * 2, destination + x * 4, width - x);
+}
+
+/**
+ * @brief Computes the unscaled lumas of eight 32-bit pixels, whose fourth byte is ignored.
+ */
+__attribute__((target("avx2"))) __m256i lumaAVX2(__m256i pixels, __m256i weights) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i low = _mm256_madd_epi16(_mm256_unpacklo_epi8(pixels, zero), weights);
+    __m256i high = _mm256_madd_epi16(_mm256_unpackhi_epi8(pixels, zero), weights);
+    return _mm256_hadd_epi32(low, high);
+}
+
+template <int Channels>
+__attribute__((target("avx2"))) void colorToGrayAVX2(const uint8_t* source, uint8_t* destination, int32_t width, const int16_t* weights) {
+    const __m256i factors = _mm256_setr_epi16(weights[0], weights[1], weights[2], 0, weights[0], weights[1], weights[2], 0,
+                                              weights[0], weights[1], weights[2], 0, weights[0], weights[1], weights[2], 0);
+    const __m256i rounding = _mm256_set1_epi32(LUMA_ROUNDING);
+    const __m256i spread = _mm256_broadcastsi128_si256(rgbSpreadShuffle<false>());
+    // Packing works per lane, leaving the lumas in the order 0-3, 8-11, 4-7, 12-15.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0);
+    int32_t x = 0;
+    for (; x + (Channels == 3 ? 18 : 16) <= width; x += 16) {
+        const uint8_t* input = source + x * Channels;
+        __m256i first;
+        __m256i second;
+        if constexpr (Channels == 3) {
+            first = _mm256_shuffle_epi8(loadLanesAVX2(input, 12), spread);
+            second = _mm256_shuffle_epi8(loadLanesAVX2(input + 24, 12), spread);
+        } else {
+            first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input));
+            second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + 32));
+        }
+        first = _mm256_srli_epi32(_mm256_add_epi32(lumaAVX2(first, factors), rounding), LUMA_SHIFT);
+        second = _mm256_srli_epi32(_mm256_add_epi32(lumaAVX2(second, factors), rounding), LUMA_SHIFT);
+        __m256i words = _mm256_packs_epi32(first, second);
+        __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(words, words), order);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x), _mm256_castsi256_si128(bytes));
+    }
+    colorToGray<Channels>(source + x * Channels, destination + x, width - x, weights);
+}
+
+#endif
+
+/**
+ * @brief The row kernels of one instruction set tier.
+ */
+struct Kernels {
+    RowKernel rgbToRGBA;
+    RowKernel rgbToBGRA;
+    RowKernel rgbaToRGB;
+    RowKernel rgbaToBGRA;
+    RowKernel grayToRGBA;
+    RowKernel grayAlphaToRGBA;
+    LumaKernel rgbToGray;
+    LumaKernel rgbaToGray;
+};
+
+/**
+ * @brief Retrieves the kernels of an instruction set tier, which the CPU must support.
+ */
+Kernels selectKernels(CpuTier tier) {
+    switch (tier) {
+#if IMAGE_HAS_X86_SIMD
+        case CpuTier::AVX2:
+            return {rgbToFourChannelsAVX2<false>, rgbToFourChannelsAVX2<true>, rgbaToRGBAVX2, rgbaToBGRAAVX2,
+                    grayToRGBAAVX2, grayAlphaToRGBAAVX2, colorToGrayAVX2<3>, colorToGrayAVX2<4>};
+        case CpuTier::SSSE3:
+            return {rgbToFourChannelsSSSE3<false>, rgbToFourChannelsSSSE3<true>, rgbaToRGBSSSE3, rgbaToBGRASSSE3,
+                    grayToRGBASSSE3, grayAlphaToRGBASSSE3, colorToGraySSSE3<3>, colorToGraySSSE3<4>};
+#endif
+        default:
+            return {rgbToRGBA, rgbToBGRA, rgbaToRGB, rgbaToBGRA, grayToRGBA, grayAlphaToRGBA, colorToGray<3>, colorToGray<4>};
+    }
+}
+
+/**
+ * @brief Retrieves the kernels of the widest instruction set the CPU supports, selected on first use.
+ */
+const Kernels& getKernels() {
+    static const Kernels kernels = selectKernels(getCpuTier());
+    return kernels;
+}
+
+/**
+ * @brief Checks that an image has a layout the channel conversions support.
+ */
+void checkConvertible(const Image& image) {
+    if (image.getSampleType() != Image::SampleType::U8) {
+        throw std::invalid_argument("Channel conversion requires 8-bit samples");
+    }
+    if (image.getChannels() < 1 || image.getChannels() > 4) {
+        throw std::invalid_argument("Channel conversion requires 1 to 4 channels, got " + std::to_string(image.getChannels()));
+    }
+}
+
+/**
+ * @brief Converts an image row by row into a new image with tightly packed rows.
+ */
+template <typename RowConverter>
+Image convertRows(const Image& image, int32_t channels, ImageAllocator& allocator, RowConverter convert_row) {
+    Image result(image.getWidth(), image.getHeight(), channels, 0, &allocator);
+    const uint8_t* source = image.getBuffer();
+    uint8_t* destination = result.getMutableBuffer();
+    for (int32_t y = 0; y < image.getHeight(); y++) {
+        convert_row(source + y * image.getStride(), destination + y * result.getStride(), image.getWidth());
+    }
+    return result;
+}
+
+} // namespace
+
+/**
+ * @brief Converts the image to RGBA.
+ */
+Image Image::toRGBA(ImageAllocator* allocator) const {
+    checkConvertible(*this);
+    ImageAllocator& target = allocator ? *allocator : getCopyAllocator();
+    const Kernels& kernels = getKernels();
+    switch (m_channels) {
+        case 1:
+            return convertRows(*this, 4, target, kernels.grayToRGBA);
+        case 2:
+            return convertRows(*this, 4, target, kernels.grayAlphaToRGBA);
+        case 3:
+            return convertRows(*this, 4, target, kernels.rgbToRGBA);
+        default:
+            return Image(ImageView(*this), &target);
+    }
+}
+
+/**
+ * @brief Converts the image to RGB.
+ */
+Image Image::toRGB(ImageAllocator* allocator) const {
+    checkConvertible(*this);
+    ImageAllocator& target = allocator ? *allocator : getCopyAllocator();
+    switch (m_channels) {
+        case 1:
+            return convertRows(*this, 3, target, grayToRGB);
+        case 2:
+            return convertRows(*this, 3, target, grayAlphaToRGB);
+        case 4:
+            return convertRows(*this, 3, target, getKernels().rgbaToRGB);
+        default:
+            return Image(ImageView(*this), &target);
+    }
+}
+
+/**
+ * @brief Converts the image to BGRA.
+ */
+Image Image::toBGRA(ImageAllocator* allocator) const {
+    checkConvertible(*this);
+    ImageAllocator& target = allocator ? *allocator : getCopyAllocator();
+    const Kernels& kernels = getKernels();
+    switch (m_channels) {
+        case 1:
+            return convertRows(*this, 4, target, kernels.grayToRGBA);
+        case 2:
+            return convertRows(*this, 4, target, kernels.grayAlphaToRGBA);
+        case 3:
+            return convertRows(*this, 4, target, kernels.rgbToBGRA);
+        default:
+            return convertRows(*this, 4, target, kernels.rgbaToBGRA);
+    }
+}
+
+/**
+ * @brief Converts the image to grayscale.
+ */
+Image Image::toGray(LumaWeights weights, ImageAllocator* allocator) const {
+    checkConvertible(*this);
+    ImageAllocator& target = allocator ? *allocator : getCopyAllocator();
+    const int16_t* factors = weights == LumaWeights::BT709 ? BT709_WEIGHTS : BT601_WEIGHTS;
+    LumaKernel kernel = m_channels == 3 ? getKernels().rgbToGray : getKernels().rgbaToGray;
+    switch (m_channels) {
+        case 2:
+            return convertRows(*this, 1, target, grayAlphaToGray);
+        case 3:
+        case 4:
+            return convertRows(*this, 1, target, [&](const uint8_t* source, uint8_t* destination, int32_t width) {
+                kernel(source, destination, width, factors);
+            });
+        default:
+            return Image(ImageView(*this), &target);
+    }
+}
@@ -0,0 +1,412 @@
+#include "image-decoder-jpeg.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#include <jerror.h>
+
+#include "image-jpeg-common.h"
+
+// Size of the staging buffer used when reading from a file or a reader.
+#define STREAM_BUFFER_SIZE 65536
+
+// Maximum number of row pointers handed to jpeg_read_scanlines at once.
+#define ROW_BATCH_SIZE 16
+
+// Source manager that hands libjpeg an in-memory buffer in one piece.
+struct MemorySource {
+    struct jpeg_source_mgr base;
+};
+
+// Source manager that pulls the compressed data from a read function through a staging buffer.
+struct StreamSource {
+    struct jpeg_source_mgr base;
+    JPEGReadFunction read;
+    void* context;
+    JOCTET buffer[STREAM_BUFFER_SIZE];
+};
+
+struct JPEGDecoder {
+    struct jpeg_decompress_struct cinfo;
+    struct JPEGErrorManager error_manager;
+    struct MemorySource memory_source;
+    struct StreamSource stream_source;
+    int output_channels;                    // Channel count of the rows handed out, including alpha.
+    bool convert_rows;                      // Whether rows go through the row buffer to be converted.
+    JSAMPLE* row_buffer;                    // Row as produced by libjpeg, before conversion.
+    size_t row_buffer_size;                 // Size of the row buffer in bytes.
+    bool active;                            // Whether a decode is in progress.
+    bool started;                           // Whether the decode in progress has been started.
+};
+
+// Marker inserted when the data ends early, which lets libjpeg finish the image.
+static const JOCTET END_OF_IMAGE[2] = { 0xFF, JPEG_EOI };
+
+// Warnings, e.g., about data that ends early, are not printed.
+static void ignoreMessage(j_common_ptr cinfo) {
+    (void)cinfo;
+}
+
+static void initSource(j_decompress_ptr cinfo) {
+    (void)cinfo;
+}
+
+static void termSource(j_decompress_ptr cinfo) {
+    (void)cinfo;
+}
+
+// Called by libjpeg when the whole buffer has been consumed: the data ended early.
+static boolean fillMemorySource(j_decompress_ptr cinfo) {
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    cinfo->src->next_input_byte = END_OF_IMAGE;
+    cinfo->src->bytes_in_buffer = sizeof(END_OF_IMAGE);
+
+    return TRUE;
+}
+
+static boolean fillStreamSource(j_decompress_ptr cinfo) {
+    struct StreamSource* source = (struct StreamSource*)cinfo->src;
+    size_t count = source->read(source->context, source->buffer, STREAM_BUFFER_SIZE);
+    if (count == 0) {
+        WARNMS(cinfo, JWRN_JPEG_EOF);
+        source->base.next_input_byte = END_OF_IMAGE;
+        source->base.bytes_in_buffer = sizeof(END_OF_IMAGE);
+        return TRUE;
+    }
+    source->base.next_input_byte = source->buffer;
+    source->base.bytes_in_buffer = count > STREAM_BUFFER_SIZE ? STREAM_BUFFER_SIZE : count;
+
+    return TRUE;
+}
+
+// Skips over data such as unused markers, refilling the buffer as often as needed.
+static void skipInput(j_decompress_ptr cinfo, long count) {
+    struct jpeg_source_mgr* source = cinfo->src;
+    if (count <= 0) {
+        return;
+    }
+    while ((size_t)count > source->bytes_in_buffer) {
+        count -= (long)source->bytes_in_buffer;
+        (void)(*source->fill_input_buffer)(cinfo);
+    }
+    source->next_input_byte += count;
+    source->bytes_in_buffer -= (size_t)count;
+}
+
+static size_t readFile(void* context, uint8_t* buffer, size_t size) {
+    return fread(buffer, 1, size, (FILE*)context);
+}
+
+// Creates the JPEG decompression object, reporting a failure instead of terminating the process.
+static bool createDecompressObject(JPEGDecoder* decoder) {
+    decoder->cinfo.err = initJPEGErrorManager(&decoder->error_manager);
+    decoder->error_manager.base.output_message = ignoreMessage;
+    if (setjmp(decoder->error_manager.jump_buffer)) {
+        return false;
+    }
+    jpeg_create_decompress(&decoder->cinfo);
+
+    return true;
+}
+
+static void initSourceManager(struct jpeg_source_mgr* source, boolean (*fill)(j_decompress_ptr)) {
+    source->init_source = initSource;
+    source->fill_input_buffer = fill;
+    source->skip_input_data = skipInput;
+    source->resync_to_restart = jpeg_resync_to_restart;
+    source->term_source = termSource;
+    source->next_input_byte = NULL;
+    source->bytes_in_buffer = 0;
+}
+
+JPEGDecoder* createJPEGDecoder(void) {
+    JPEGDecoder* decoder = (JPEGDecoder*)malloc(sizeof(JPEGDecoder));
+    if (!decoder) {
+        return NULL;
+    }
+
+    // Create the JPEG decompression object once; it is reused for every image.
+    if (!createDecompressObject(decoder)) {
+        free(decoder);
+        return NULL;
+    }
+
+    initSourceManager(&decoder->memory_source.base, fillMemorySource);
+    initSourceManager(&decoder->stream_source.base, fillStreamSource);
+    decoder->stream_source.read = NULL;
+    decoder->stream_source.context = NULL;
+
+    decoder->output_channels = 0;
+    decoder->convert_rows = false;
+    decoder->row_buffer = NULL;
+    decoder->row_buffer_size = 0;
+    decoder->active = false;
+    decoder->started = false;
+
+    return decoder;
+}
+
+void destroyJPEGDecoder(JPEGDecoder* decoder) {
+    if (!decoder) {
+        return;
+    }
+    abortJPEGDecode(decoder);
+    jpeg_destroy_decompress(&decoder->cinfo);
+    free(decoder->row_buffer);
+    free(decoder);
+}
+
+// Ends the decode in progress, if any. When `success` is false the decompression is aborted, which
+// keeps the decompression object reusable. Returns `success`.
+static bool endDecode(JPEGDecoder* decoder, bool success) {
+    if (!success && decoder->active) {
+        jpeg_abort_decompress(&decoder->cinfo);
+    }
+    decoder->active = false;
+    decoder->started = false;
+    decoder->stream_source.read = NULL;
+    decoder->stream_source.context = NULL;
+
+    return success;
+}
+
+// Ends the decode in progress with a failure that libjpeg did not report itself.
+static bool failDecode(JPEGDecoder* decoder, const char* message) {
+    strncpy(decoder->error_manager.message, message, JMSG_LENGTH_MAX - 1);
+    decoder->error_manager.message[JMSG_LENGTH_MAX - 1] = '\0';
+    return endDecode(decoder, false);
+}
+
+// Converts a row of gray, RGB or CMYK pixels produced by libjpeg to the requested channel count.
+// CMYK is converted to RGB by scaling each color with the black channel, and gray is computed from
+// RGB with the BT.601 weights, both the way stb_image does.
+static void convertRow(const JSAMPLE* input, int input_components, uint8_t* output, int output_channels, JDIMENSION width) {
+    for (JDIMENSION x = 0; x < width; x++, input += input_components, output += output_channels) {
+        unsigned red = input[0];
+        unsigned green = input[0];
+        unsigned blue = input[0];
+        if (input_components == 3) {
+            green = input[1];
+            blue = input[2];
+        } else if (input_components == 4) {
+            red = divideBy255(input[0] * input[3]);
+            green = divideBy255(input[1] * input[3]);
+            blue = divideBy255(input[2] * input[3]);
+        }
+
+        if (output_channels <= 2) {
+            output[0] = input_components == 1 ? input[0] : (uint8_t)((77 * red + 150 * green + 29 * blue) >> 8);
+        } else {
+            output[0] = (uint8_t)red;
+            output[1] = (uint8_t)green;
+            output[2] = (uint8_t)blue;
+        }
+        if (output_channels == 2 || output_channels == 4) {
+            output[output_channels - 1] = 255;
+        }
+    }
+}
+
+// Reads the header from the source manager currently installed on the decoder.
+static bool beginDecode(JPEGDecoder* decoder, int* width, int* height, int* number_of_channels) {
+    struct jpeg_decompress_struct* cinfo = &decoder->cinfo;
+    decoder->error_manager.message[0] = '\0';
+
+    // Set up error handling with setjmp/longjmp.
+    if (setjmp(decoder->error_manager.jump_buffer)) {
+        return endDecode(decoder, false);
+    }
+
+    decoder->active = true;
+    jpeg_read_header(cinfo, TRUE);
+
+    switch (cinfo->jpeg_color_space) {
+    case JCS_GRAYSCALE:
+        *number_of_channels = 1;
+        break;
+    case JCS_RGB:
+    case JCS_YCbCr:
+    case JCS_CMYK:
+    case JCS_YCCK:
+        *number_of_channels = 3;
+        break;
+    default:
+        return failDecode(decoder, "Unsupported JPEG color space");
+    }
+    *width = (int)cinfo->image_width;
+    *height = (int)cinfo->image_height;
+
+    return true;
+}
+
+bool beginJPEGDecode(JPEGDecoder* decoder, FILE* fp, int* width, int* height, int* number_of_channels) {
+    return beginJPEGDecodeFromReader(decoder, readFile, fp, width, height, number_of_channels);
+}
+
+bool beginJPEGDecodeFromMemory(JPEGDecoder* decoder, const uint8_t* data, size_t size, int* width, int* height, int* number_of_channels) {
+
+    // Finish off any decode that was left in progress.
+    abortJPEGDecode(decoder);
+
+    decoder->memory_source.base.next_input_byte = data;
+    decoder->memory_source.base.bytes_in_buffer = size;
+    decoder->cinfo.src = &decoder->memory_source.base;
+
+    return beginDecode(decoder, width, height, number_of_channels);
+}
+
+bool beginJPEGDecodeFromReader(JPEGDecoder* decoder, JPEGReadFunction read, void* context, int* width, int* height, int* number_of_channels) {
+
+    // Finish off any decode that was left in progress.
+    abortJPEGDecode(decoder);
+
+    decoder->stream_source.read = read;
+    decoder->stream_source.context = context;
+    decoder->stream_source.base.next_input_byte = NULL;
+    decoder->stream_source.base.bytes_in_buffer = 0;
+    decoder->cinfo.src = &decoder->stream_source.base;
+
+    return beginDecode(decoder, width, height, number_of_channels);
+}
+
+bool startJPEGDecode(JPEGDecoder* decoder, int scale_denom, int number_of_channels, int* width, int* height) {
+    if (!decoder->active || decoder->started) {
+        return false;
+    }
+    if ((scale_denom != 1 && scale_denom != 2 && scale_denom != 4 && scale_denom != 8) || number_of_channels < 0 || number_of_channels > 4) {
+        return failDecode(decoder, "Invalid JPEG scale or channel count");
+    }
+
+    struct jpeg_decompress_struct* cinfo = &decoder->cinfo;
+    if (number_of_channels == 0) {
+        number_of_channels = cinfo->jpeg_color_space == JCS_GRAYSCALE ? 1 : 3;
+    }
+
+    // Let libjpeg produce the requested channels where it can, so rows go straight to the caller.
+    // Gray output from YCbCr also skips the chroma components altogether.
+    switch (cinfo->jpeg_color_space) {
+    case JCS_GRAYSCALE:
+        cinfo->out_color_space = JCS_GRAYSCALE;
+        break;
+    case JCS_CMYK:
+    case JCS_YCCK:
+        cinfo->out_color_space = JCS_CMYK;
+        break;
+    default:
+        if (number_of_channels <= 2 && cinfo->jpeg_color_space == JCS_YCbCr) {
+            cinfo->out_color_space = JCS_GRAYSCALE;
+        } else {
+            cinfo->out_color_space = JCS_RGB;
+#ifdef JCS_EXTENSIONS
+            if (number_of_channels == 4) {
+                cinfo->out_color_space = JCS_EXT_RGBA;
+            }
+#endif
+        }
+        break;
+    }
+    cinfo->scale_num = 1;
+    cinfo->scale_denom = (unsigned int)scale_denom;
+
+    // Set up error handling with setjmp/longjmp.
+    if (setjmp(decoder->error_manager.jump_buffer)) {
+        return endDecode(decoder, false);
+    }
+
+    jpeg_start_decompress(cinfo);
+    decoder->started = true;
+    decoder->output_channels = number_of_channels;
+
+    // Rows that need converting go through a single row buffer, reused across decodes. CMYK rows
+    // always do, even when the channel counts happen to match.
+    decoder->convert_rows = cinfo->out_color_space == JCS_CMYK || cinfo->output_components != number_of_channels;
+    if (decoder->convert_rows) {
+        size_t row_size = (size_t)cinfo->output_width * cinfo->output_components;
+        if (row_size > decoder->row_buffer_size) {
+            JSAMPLE* row_buffer = (JSAMPLE*)realloc(decoder->row_buffer, row_size);
+            if (!row_buffer) {
+                return failDecode(decoder, "Insufficient memory");
+            }
+            decoder->row_buffer = row_buffer;
+            decoder->row_buffer_size = row_size;
+        }
+    }
+
+    *width = (int)cinfo->output_width;
+    *height = (int)cinfo->output_height;
+
+    return true;
+}
+
+bool readJPEGRows(JPEGDecoder* decoder, uint8_t* rows, int count, size_t stride) {
+    if (!decoder->started) {
+        return false;
+    }
+
+    struct jpeg_decompress_struct* cinfo = &decoder->cinfo;
+    if (count < 0 || (JDIMENSION)count > cinfo->output_height - cinfo->output_scanline) {
+        return failDecode(decoder, "Too many JPEG rows requested");
+    }
+    const size_t row_stride = stride ? stride : (size_t)cinfo->output_width * decoder->output_channels;
+
+    // Set up error handling with setjmp/longjmp.
+    if (setjmp(decoder->error_manager.jump_buffer)) {
+        return endDecode(decoder, false);
+    }
+
+    // Rows that need converting are read into the row buffer one at a time.
+    if (decoder->convert_rows) {
+        JSAMPROW row_pointer = decoder->row_buffer;
+        for (int i = 0; i < count; i++) {
+            if (jpeg_read_scanlines(cinfo, &row_pointer, 1) != 1) {
+                return failDecode(decoder, "JPEG data is suspended");
+            }
+            convertRow(decoder->row_buffer, cinfo->output_components, rows + (size_t)i * row_stride, decoder->output_channels, cinfo->output_width);
+        }
+        return true;
+    }
+
+    // Read the image data, handing libjpeg a batch of row pointers at a time.
+    JSAMPROW row_pointers[ROW_BATCH_SIZE];
+    int read = 0;
+    while (read < count) {
+        int batch = count - read < ROW_BATCH_SIZE ? count - read : ROW_BATCH_SIZE;
+        for (int i = 0; i < batch; i++) {
+            row_pointers[i] = (JSAMPROW)(rows + (size_t)(read + i) * row_stride);
+        }
+        JDIMENSION lines = jpeg_read_scanlines(cinfo, row_pointers, (JDIMENSION)batch);
+        if (lines == 0) {
+            return failDecode(decoder, "JPEG data is suspended");
+        }
+        read += (int)lines;
+    }
+
+    return true;
+}
+
+bool finishJPEGDecode(JPEGDecoder* decoder) {
+    if (!decoder->started) {
+        return false;
+    }
+
+    // libjpeg reports an error if fewer rows than the image height were read.
+    if (setjmp(decoder->error_manager.jump_buffer)) {
+        return endDecode(decoder, false);
+    }
+
+    // Finish decompression. The decompression object is left ready for the next image.
+    jpeg_finish_decompress(&decoder->cinfo);
+
+    return endDecode(decoder, true);
+}
+
+void abortJPEGDecode(JPEGDecoder* decoder) {
+    if (decoder->active) {
+        endDecode(decoder, false);
+    }
+}
+
+const char* getJPEGDecodeError(const JPEGDecoder* decoder) {
+    return decoder->error_manager.message;
+}
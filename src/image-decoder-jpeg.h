@@ -0,0 +1,56 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Supplies compressed bytes to a decode: reads up to size bytes into buffer and returns the number of
+ * bytes read. Zero signals the end of the data.
+ */
+typedef size_t (*JPEGReadFunction)(void* context, uint8_t* buffer, size_t size);
+
+/**
+ * Persistent JPEG decompression context. The decompression object is created once and reused for
+ * every image decoded with the same context.
+ */
+typedef struct JPEGDecoder JPEGDecoder;
+
+JPEGDecoder* createJPEGDecoder(void);
+
+void destroyJPEGDecoder(JPEGDecoder* decoder);
+
+/**
+ * Row-by-row decoding. A decode is started with one of the begin functions, which read the header and
+ * report the stored dimensions and channel count (1 for grayscale, 3 for color images). It is set up
+ * with startJPEGDecode, read with readJPEGRows until all rows have been read and completed with
+ * finishJPEGDecode. Any failure ends the decode, after which the context is ready for a new one and
+ * getJPEGDecodeError describes the failure.
+ *
+ * The file of beginJPEGDecode is read from its current position and is not closed by the decoder.
+ * Data that ends early is completed with an end of image marker, as libjpeg does, rather than failing.
+ */
+bool beginJPEGDecode(JPEGDecoder* decoder, FILE* fp, int* width, int* height, int* number_of_channels);
+
+bool beginJPEGDecodeFromMemory(JPEGDecoder* decoder, const uint8_t* data, size_t size, int* width, int* height, int* number_of_channels);
+
+bool beginJPEGDecodeFromReader(JPEGDecoder* decoder, JPEGReadFunction read, void* context, int* width, int* height, int* number_of_channels);
+
+/**
+ * Sets up the decode to reduce the image by 1/scale_denom (1, 2, 4 or 8) in the inverse DCT, and to
+ * output number_of_channels channels: 1 (gray), 2 (gray and alpha), 3 (RGB) or 4 (RGBA), or 0 for the
+ * stored channel count. Gray is taken from the luma of YCbCr images, and alpha is fully opaque.
+ * Reports the dimensions of the reduced image.
+ */
+bool startJPEGDecode(JPEGDecoder* decoder, int scale_denom, int number_of_channels, int* width, int* height);
+
+bool readJPEGRows(JPEGDecoder* decoder, uint8_t* rows, int count, size_t stride);
+
+bool finishJPEGDecode(JPEGDecoder* decoder);
+
+void abortJPEGDecode(JPEGDecoder* decoder);
+
+/**
+ * Describes the failure that ended the last decode, or returns an empty string if there was none.
+ */
+const char* getJPEGDecodeError(const JPEGDecoder* decoder);
@@ -1,20 +1,691 @@
 #include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <memory>
+#include <new>
+#include <vector>
 
 #include "image-decoder.h"
 #include "stb_image.h"
 #include "image.h"
+#include "thread-pool.h"
+#include "mapped-file.h"
+#include "stb-allocator.h"
+
+extern "C" {
+#include "image-decoder-jpeg.h"
+}
+
+namespace {
+
+/**
+ * @brief Number of leading bytes needed to recognize any of the supported formats.
+ */
+constexpr size_t SIGNATURE_SIZE = 11;
+
+/**
+ * @brief Identifies the encoded format of an image from its leading bytes.
+ * 
+ * Should only be called for data that stb_image has already recognized as an image. TGA has no
+ * signature, so it is reported for recognized data that matches none of the other formats (stb_image
+ * tries TGA last for the same reason).
+ */
+ImageDecoder::Format detectFormat(const uint8_t* bytes, size_t size) {
+    auto startsWith = [bytes, size](const char* signature, size_t length) {
+        return size >= length && std::memcmp(bytes, signature, length) == 0;
+    };
+
+    if (startsWith("\x89PNG\r\n\x1a\n", 8)) {
+        return ImageDecoder::Format::PNG;
+    }
+    if (startsWith("\xff\xd8\xff", 3)) {
+        return ImageDecoder::Format::JPEG;
+    }
+    if (startsWith("GIF8", 4)) {
+        return ImageDecoder::Format::GIF;
+    }
+    if (startsWith("BM", 2)) {
+        return ImageDecoder::Format::BMP;
+    }
+    if (startsWith("8BPS", 4)) {
+        return ImageDecoder::Format::PSD;
+    }
+    if (startsWith("\x53\x80\xf6\x34", 4)) {
+        return ImageDecoder::Format::PIC;
+    }
+    if (startsWith("P5", 2) || startsWith("P6", 2)) {
+        return ImageDecoder::Format::PNM;
+    }
+    if (startsWith("#?RADIANCE", 10) || startsWith("#?RGBE", 6)) {
+        return ImageDecoder::Format::HDR;
+    }
+    return ImageDecoder::Format::TGA;
+}
+
+/**
+ * @brief Validates that a memory buffer can be handed to stb_image, which takes the length as an int.
+ */
+int checkedBufferSize(std::span<const uint8_t> data, const char* operation) {
+    if (data.empty() || data.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        throw std::runtime_error(std::string(operation) + " from memory: invalid buffer size");
+    }
+    return static_cast<int>(data.size());
+}
+
+/**
+ * @brief Retrieves the reason for the last stb_image failure on the calling thread.
+ */
+const char* failureReason() {
+    const char* reason = stbi_failure_reason();
+    return reason ? reason : "unknown error";
+}
+
+/**
+ * @brief Number of leading bytes of a stream read ahead to inspect its header. Covers the header
+ * fields that tell 16-bit and high dynamic range images apart in all supported formats.
+ */
+constexpr size_t STREAM_HEADER_SIZE = 256;
+
+/**
+ * @brief Adapts an ImageDecoder::Reader to stb_image's I/O callbacks. Exceptions thrown by the
+ * reader are captured, reported to stb_image as the end of the data and rethrown afterwards.
+ * Bytes read ahead with peekHeader() are replayed to stb_image before the rest of the stream.
+ */
+struct ReaderCallbacks {
+    ImageDecoder::Reader& reader;
+    std::exception_ptr exception;
+    std::vector<uint8_t> header = {};   // Bytes read ahead of the decoder.
+    size_t header_offset = 0;           // Number of read ahead bytes already handed to the decoder.
+    bool peeked = false;                // Whether the header has been read ahead.
+
+    /**
+     * @brief Reads from the reader until `size` bytes have been read or the data ends.
+     */
+    size_t fill(uint8_t* data, size_t size) {
+        // stb_image treats a short read as the end of the data, while pipes and sockets commonly
+        // return less than requested, so keep reading until the request is filled.
+        size_t total = 0;
+        while (total < size) {
+            size_t count = reader.read(data + total, size - total);
+            if (count == 0) {
+                break;
+            }
+            total += std::min(count, size - total);
+        }
+        return total;
+    }
+
+    /**
+     * @brief Reads ahead the leading bytes of the stream, without consuming them. Must be called
+     * before the decoder starts reading.
+     */
+    std::span<const uint8_t> peekHeader() {
+        if (! peeked) {
+            header.resize(STREAM_HEADER_SIZE);
+            header.resize(fill(header.data(), header.size()));
+            header_offset = 0;
+            peeked = true;
+        }
+        return header;
+    }
+
+    /**
+     * @brief Reads up to `size` bytes for the decoder, replaying the read ahead bytes first. Also
+     * serves as the read function of libjpeg decodes.
+     */
+    static size_t pull(void* user, uint8_t* data, size_t size) {
+        auto* callbacks = static_cast<ReaderCallbacks*>(user);
+        if (callbacks->exception) {
+            return 0;
+        }
+        try {
+            size_t replayed = std::min(size, callbacks->header.size() - callbacks->header_offset);
+            if (replayed > 0) {
+                std::memcpy(data, callbacks->header.data() + callbacks->header_offset, replayed);
+                callbacks->header_offset += replayed;
+            }
+            return replayed + callbacks->fill(data + replayed, size - replayed);
+        } catch (...) {
+            callbacks->exception = std::current_exception();
+            return 0;
+        }
+    }
+
+    static int read(void* user, char* data, int size) {
+        if (size <= 0) {
+            return 0;
+        }
+        return static_cast<int>(pull(user, reinterpret_cast<uint8_t*>(data), static_cast<size_t>(size)));
+    }
+
+    static void skip(void* user, int count) {
+        auto* callbacks = static_cast<ReaderCallbacks*>(user);
+        if (callbacks->exception) {
+            return;
+        }
+        try {
+            // Skip within the read ahead bytes first; only what lies beyond them reaches the reader.
+            size_t remaining = callbacks->header.size() - callbacks->header_offset;
+            if (remaining > 0 && count >= 0) {
+                size_t skipped = std::min(static_cast<size_t>(count), remaining);
+                callbacks->header_offset += skipped;
+                count -= static_cast<int>(skipped);
+            } else if (remaining > 0 && static_cast<size_t>(-static_cast<int64_t>(count)) <= callbacks->header_offset) {
+                callbacks->header_offset -= static_cast<size_t>(-static_cast<int64_t>(count));
+                count = 0;
+            }
+            if (count != 0) {
+                callbacks->reader.skip(count);
+            }
+        } catch (...) {
+            callbacks->exception = std::current_exception();
+        }
+    }
+
+    static int eof(void* user) {
+        auto* callbacks = static_cast<ReaderCallbacks*>(user);
+        if (callbacks->exception) {
+            return 1;
+        }
+        if (callbacks->header_offset < callbacks->header.size()) {
+            return 0;
+        }
+        try {
+            return callbacks->reader.eof() ? 1 : 0;
+        } catch (...) {
+            callbacks->exception = std::current_exception();
+            return 1;
+        }
+    }
+
+    static constexpr stbi_io_callbacks functions = { read, skip, eof };
+};
+
+/**
+ * @brief Checks whether an open image file stores HDR or 16-bit samples. The stb_image *_from_file
+ * functions restore the file position, so the handle can be shared with other reads of the file.
+ */
+void probeFileSampleDepth(FILE* file, bool& is_hdr, bool& is_16_bit) {
+    is_hdr = stbi_is_hdr_from_file(file) != 0;
+    is_16_bit = stbi_is_16_bit_from_file(file) != 0;
+}
+
+/**
+ * @brief Where the encoded image comes from: a file path, an in-memory buffer or a reader.
+ * A file path combined with a buffer denotes a file that has been mapped into memory.
+ */
+struct Source {
+    const std::string* filepath;
+    std::span<const uint8_t> data;
+    ReaderCallbacks* callbacks;
+
+    /**
+     * @brief Describes the source for error messages.
+     */
+    std::string describe() const {
+        if (filepath) {
+            return "at " + *filepath;
+        }
+        return callbacks ? "from reader" : "from memory";
+    }
+
+    /**
+     * @brief Determines the sample type to decode the source to. Unreadable sources yield
+     * SampleType::U8 and are left for load() to report.
+     */
+    Image::SampleType sampleType(ImageDecoder::SampleDepth sample_depth) const {
+        if (sample_depth == ImageDecoder::SampleDepth::Always8Bit) {
+            return Image::SampleType::U8;
+        }
+
+        bool is_hdr = false;
+        bool is_16_bit = false;
+        if (callbacks || ! filepath || ! data.empty()) {
+            std::span<const uint8_t> bytes = callbacks ? callbacks->peekHeader() : data;
+            if (! bytes.empty() && bytes.size() <= static_cast<size_t>(std::numeric_limits<int>::max())) {
+                is_hdr = stbi_is_hdr_from_memory(bytes.data(), static_cast<int>(bytes.size())) != 0;
+                is_16_bit = stbi_is_16_bit_from_memory(bytes.data(), static_cast<int>(bytes.size())) != 0;
+            }
+        } else if (FILE* file = std::fopen(filepath->c_str(), "rb")) {
+            probeFileSampleDepth(file, is_hdr, is_16_bit);
+            std::fclose(file);
+        }
+
+        if (is_hdr) {
+            return Image::SampleType::F32;
+        }
+        return is_16_bit ? Image::SampleType::U16 : Image::SampleType::U8;
+    }
+
+    /**
+     * @brief Decodes the source with stb_image to samples of the specified type, converting the pixels
+     * to `desired_channels` channels unless it is zero. `channels` receives the channel count stored
+     * in the source. Returns nullptr on failure.
+     */
+    uint8_t* load(int32_t* width, int32_t* height, int32_t* channels, Image::SampleType sample_type, int32_t desired_channels) const {
+        if (callbacks) {
+            switch (sample_type) {
+            case Image::SampleType::U16:
+                return reinterpret_cast<uint8_t*>(stbi_load_16_from_callbacks(&ReaderCallbacks::functions, callbacks, width, height, channels, desired_channels));
+            case Image::SampleType::F32:
+                return reinterpret_cast<uint8_t*>(stbi_loadf_from_callbacks(&ReaderCallbacks::functions, callbacks, width, height, channels, desired_channels));
+            default:
+                return stbi_load_from_callbacks(&ReaderCallbacks::functions, callbacks, width, height, channels, desired_channels);
+            }
+        }
+        if (filepath && data.empty()) {
+            switch (sample_type) {
+            case Image::SampleType::U16:
+                return reinterpret_cast<uint8_t*>(stbi_load_16(filepath->c_str(), width, height, channels, desired_channels));
+            case Image::SampleType::F32:
+                return reinterpret_cast<uint8_t*>(stbi_loadf(filepath->c_str(), width, height, channels, desired_channels));
+            default:
+                return stbi_load(filepath->c_str(), width, height, channels, desired_channels);
+            }
+        }
+        if (data.empty() || data.size() > static_cast<size_t>(std::numeric_limits<int>::max())) {
+            throw std::runtime_error("Failed to decode image " + describe() + ": invalid buffer size");
+        }
+        int size = static_cast<int>(data.size());
+        switch (sample_type) {
+        case Image::SampleType::U16:
+            return reinterpret_cast<uint8_t*>(stbi_load_16_from_memory(data.data(), size, width, height, channels, desired_channels));
+        case Image::SampleType::F32:
+            return reinterpret_cast<uint8_t*>(stbi_loadf_from_memory(data.data(), size, width, height, channels, desired_channels));
+        default:
+            return stbi_load_from_memory(data.data(), size, width, height, channels, desired_channels);
+        }
+    }
+};
+
+/**
+ * @brief Retrieves the libjpeg decompression context of the calling thread, created on first use.
+ */
+JPEGDecoder* threadJPEGDecoder() {
+    thread_local std::unique_ptr<JPEGDecoder, void (*)(JPEGDecoder*)> decoder(nullptr, destroyJPEGDecoder);
+    if (! decoder) {
+        decoder.reset(createJPEGDecoder());
+        if (! decoder) {
+            throw std::bad_alloc();
+        }
+    }
+    return decoder.get();
+}
+
+/**
+ * @brief Picks the largest DCT scaling denominator (8, 4 or 2) that keeps an image at least as large
+ * as the target size, or 1 if the image cannot be reduced. libjpeg rounds reduced dimensions up.
+ */
+int32_t scaleDenominator(int32_t width, int32_t height, int32_t target_width, int32_t target_height) {
+    for (int32_t denominator = 8; denominator > 1; denominator /= 2) {
+        if ((width + denominator - 1) / denominator >= target_width && (height + denominator - 1) / denominator >= target_height) {
+            return denominator;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Decodes a JPEG source with libjpeg, reduced towards a target size in the inverse DCT. Any
+ * decode left in progress is aborted on destruction.
+ */
+class JPEGSourceDecoder {
+    const Source& m_source;
+    JPEGDecoder* m_decoder;
+    FILE* m_file = nullptr;
+
+public:
+    explicit JPEGSourceDecoder(const Source& source) : m_source(source), m_decoder(threadJPEGDecoder()) {}
+
+    JPEGSourceDecoder(const JPEGSourceDecoder& other) = delete;
+    JPEGSourceDecoder& operator=(const JPEGSourceDecoder& other) = delete;
+
+    ~JPEGSourceDecoder() {
+        abortJPEGDecode(m_decoder);
+        if (m_file) {
+            std::fclose(m_file);
+        }
+    }
+
+    /**
+     * @brief Reads the header if the source is a JPEG image, filling in `info` with the stored
+     * properties. Returns false, with the source left for stb_image, otherwise.
+     */
+    bool begin(ImageDecoder::Info& info) {
+        auto isJPEG = [](std::span<const uint8_t> bytes) {
+            return ! bytes.empty() && detectFormat(bytes.data(), bytes.size()) == ImageDecoder::Format::JPEG;
+        };
+
+        bool begun;
+        if (m_source.callbacks) {
+            if (! isJPEG(m_source.callbacks->peekHeader())) {
+                return false;
+            }
+            begun = beginJPEGDecodeFromReader(m_decoder, ReaderCallbacks::pull, m_source.callbacks, &info.width, &info.height, &info.channels);
+        } else if (! m_source.data.empty()) {
+            if (! isJPEG(m_source.data)) {
+                return false;
+            }
+            begun = beginJPEGDecodeFromMemory(m_decoder, m_source.data.data(), m_source.data.size(), &info.width, &info.height, &info.channels);
+        } else if (m_source.filepath && (m_file = std::fopen(m_source.filepath->c_str(), "rb"))) {
+            uint8_t signature[SIGNATURE_SIZE];
+            size_t signature_size = std::fread(signature, 1, sizeof(signature), m_file);
+            if (! isJPEG({signature, signature_size}) || std::fseek(m_file, 0, SEEK_SET) != 0) {
+                return false;
+            }
+            begun = beginJPEGDecode(m_decoder, m_file, &info.width, &info.height, &info.channels);
+        } else {
+            return false;
+        }
+        check(begun);
+
+        info.format = ImageDecoder::Format::JPEG;
+        return true;
+    }
+
+    /**
+     * @brief Sets up the reduced decode, updating `info` to the properties of the decoded image.
+     */
+    void start(int32_t target_width, int32_t target_height, int32_t desired_channels, ImageDecoder::Info& info) {
+        int32_t denominator = scaleDenominator(info.width, info.height, target_width, target_height);
+        check(startJPEGDecode(m_decoder, denominator, desired_channels, &info.width, &info.height));
+        if (desired_channels != 0) {
+            info.channels = desired_channels;
+        }
+    }
+
+    /**
+     * @brief Decodes all rows into `destination`, `stride` bytes apart, and completes the decode.
+     */
+    void read(uint8_t* destination, size_t stride, int32_t height) {
+        check(readJPEGRows(m_decoder, destination, height, stride) && finishJPEGDecode(m_decoder));
+    }
+
+private:
+
+    /**
+     * @brief Throws if a step of the decode failed, or if the reader threw.
+     */
+    void check(bool success) const {
+        // libjpeg sees a failing reader as data that ends early, so its exception takes precedence.
+        if (m_source.callbacks && m_source.callbacks->exception) {
+            std::rethrow_exception(m_source.callbacks->exception);
+        }
+        if (! success) {
+            throw std::runtime_error("Failed to decode image " + m_source.describe() + ": " + getJPEGDecodeError(m_decoder));
+        }
+    }
+};
+
+/**
+ * @brief Throws if an image with the specified dimensions doesn't fit into the destination buffer.
+ * Returns the row stride to use.
+ */
+size_t checkDestination(const Source& source, int32_t width, int32_t height, int32_t channels, Image::SampleType sample_type, std::span<uint8_t> destination, size_t stride) {
+    size_t row_size = static_cast<size_t>(width) * channels * Image::getSampleSize(sample_type);
+    if (stride == 0) {
+        stride = row_size;
+    }
+    if (stride < row_size || (height > 0 && (destination.size() < row_size || (destination.size() - row_size) / stride < static_cast<size_t>(height - 1)))) {
+        throw std::length_error("Failed to decode image " + source.describe() + ": destination buffer is too small for "
+            + std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(channels) + " pixels");
+    }
+    return stride;
+}
+
+/**
+ * @brief Decodes an image from any source into a caller-provided buffer.
+ */
+ImageDecoder::Info decodeSourceInto(const Source& source, ImageAllocator* allocator, ImageDecoder::SampleDepth sample_depth, int32_t desired_channels,
+                                    int32_t target_width, int32_t target_height, std::span<uint8_t> destination, size_t stride) {
+    ImageDecoder::Info info;
+
+    // With a target size, JPEG images are reduced while decoding, straight into the destination.
+    if (target_width > 0 || target_height > 0) {
+        JPEGSourceDecoder jpeg(source);
+        if (jpeg.begin(info)) {
+            jpeg.start(target_width, target_height, desired_channels, info);
+            stride = checkDestination(source, info.width, info.height, info.channels, Image::SampleType::U8, destination, stride);
+            jpeg.read(destination.data(), stride, info.height);
+            return info;
+        }
+    }
+
+    Image::SampleType sample_type = source.sampleType(sample_depth);
+    info.is16Bit = sample_type == Image::SampleType::U16;
+    info.isHDR = sample_type == Image::SampleType::F32;
+
+    // Serve stb_image's scratch and output memory from the decoder's allocator, or recycle it
+    // across calls on this thread when there is none.
+    StbAllocationScope scope(allocator);
+
+    // Reject images that don't fit before paying for the decode, when the header can be inspected.
+    if (! source.callbacks) {
+        bool recognized = source.filepath && source.data.empty()
+            ? stbi_info(source.filepath->c_str(), &info.width, &info.height, &info.channels)
+            : stbi_info_from_memory(source.data.data(), static_cast<int>(std::min(source.data.size(), static_cast<size_t>(std::numeric_limits<int>::max()))), &info.width, &info.height, &info.channels);
+        if (! recognized) {
+            throw std::runtime_error("Failed to decode image " + source.describe() + ": " + failureReason());
+        }
+        if (desired_channels != 0) {
+            info.channels = desired_channels;
+        }
+        checkDestination(source, info.width, info.height, info.channels, sample_type, destination, stride);
+        if (! source.data.empty()) {
+            info.format = detectFormat(source.data.data(), source.data.size());
+        }
+    }
+
+    uint8_t* buffer = source.load(&info.width, &info.height, &info.channels, sample_type, desired_channels);
+    if (source.callbacks && source.callbacks->exception) {
+        stbi_image_free(buffer);
+        std::rethrow_exception(source.callbacks->exception);
+    }
+    if (! buffer) {
+        throw std::runtime_error("Failed to decode image " + source.describe() + ": " + failureReason());
+    }
+    if (desired_channels != 0) {
+        info.channels = desired_channels;
+    }
+
+    size_t row_size = static_cast<size_t>(info.width) * info.channels * Image::getSampleSize(sample_type);
+    try {
+        stride = checkDestination(source, info.width, info.height, info.channels, sample_type, destination, stride);
+    } catch (...) {
+        stbi_image_free(buffer);
+        throw;
+    }
+    for (int32_t y = 0; y < info.height; y++) {
+        std::memcpy(destination.data() + y * stride, buffer + y * row_size, row_size);
+    }
+    stbi_image_free(buffer);
+
+    return info;
+}
+
+/**
+ * @brief Decodes an image from any source into an Image that owns the stb_image allocated pixels.
+ */
+Image decodeSource(const Source& source, ImageAllocator* allocator, ImageDecoder::SampleDepth sample_depth, int32_t desired_channels, int32_t target_width, int32_t target_height) {
+    // With a target size, JPEG images are reduced while decoding.
+    if (target_width > 0 || target_height > 0) {
+        JPEGSourceDecoder jpeg(source);
+        ImageDecoder::Info info;
+        if (jpeg.begin(info)) {
+            jpeg.start(target_width, target_height, desired_channels, info);
+            Image image(info.width, info.height, info.channels, 0, allocator);
+            jpeg.read(image.getMutableBuffer(), image.getStride(), info.height);
+            return image;
+        }
+    }
 
-Image ImageDecoder::decodeImage(const std::string& filepath) const {
     int32_t width;
     int32_t height;
     int32_t channels;
 
-    uint8_t* buffer = stbi_load(filepath.c_str(), &width, &height, &channels, 0);
+    // Without an allocator, the pixels come from the default allocator without per-thread caching.
+    std::optional<StbAllocationScope> scope;
+    if (allocator) {
+        scope.emplace(allocator);
+    }
+
+    Image::SampleType sample_type = source.sampleType(sample_depth);
+    uint8_t* buffer = source.load(&width, &height, &channels, sample_type, desired_channels);
+    if (source.callbacks && source.callbacks->exception) {
+        stbi_image_free(buffer);
+        std::rethrow_exception(source.callbacks->exception);
+    }
     if (! buffer) {
-        throw std::runtime_error(std::string("Failed to decode image at ") + filepath);
+        throw std::runtime_error("Failed to decode image " + source.describe() + ": " + failureReason());
+    }
+    if (desired_channels != 0) {
+        channels = desired_channels;
     }
-    
-    return Image(buffer, width, height, channels, [](void* data) {
-        stbi_image_free(data); 
+
+    // Blocks remember their allocator, so stbi_image_free returns the pixels to the right one.
+    return Image(buffer, width, height, channels, sample_type, 0, [](void* data) {
+        stbi_image_free(data);
     });
 }
+
+} // namespace
+
+void ImageDecoder::setInputMode(InputMode input_mode) {
+    m_input_mode = input_mode;
+}
+
+ImageDecoder::InputMode ImageDecoder::getInputMode() const {
+    return m_input_mode;
+}
+
+void ImageDecoder::setAllocator(ImageAllocator* allocator) {
+    m_allocator = allocator;
+}
+
+ImageAllocator* ImageDecoder::getAllocator() const {
+    return m_allocator;
+}
+
+void ImageDecoder::setSampleDepth(SampleDepth sample_depth) {
+    m_sample_depth = sample_depth;
+}
+
+ImageDecoder::SampleDepth ImageDecoder::getSampleDepth() const {
+    return m_sample_depth;
+}
+
+void ImageDecoder::setChannels(int32_t channels) {
+    if (channels < 0 || channels > 4) {
+        throw std::invalid_argument("Decoded channel count must be between 0 and 4");
+    }
+    m_channels = channels;
+}
+
+int32_t ImageDecoder::getChannels() const {
+    return m_channels;
+}
+
+void ImageDecoder::setTargetSize(int32_t width, int32_t height) {
+    if (width < 0 || height < 0) {
+        throw std::invalid_argument("Target size must not be negative");
+    }
+    m_target_width = width;
+    m_target_height = height;
+}
+
+int32_t ImageDecoder::getTargetWidth() const {
+    return m_target_width;
+}
+
+int32_t ImageDecoder::getTargetHeight() const {
+    return m_target_height;
+}
+
+Image ImageDecoder::decodeImage(const std::string& filepath) const {
+    if (m_input_mode == InputMode::MemoryMapped && MappedFile::isSupported()) {
+        MappedFile file(filepath);
+        return decodeSource(Source{&filepath, file.getData(), nullptr}, m_allocator, m_sample_depth, m_channels, m_target_width, m_target_height);
+    }
+    return decodeSource(Source{&filepath, {}, nullptr}, m_allocator, m_sample_depth, m_channels, m_target_width, m_target_height);
+}
+
+Image ImageDecoder::decodeImage(std::span<const uint8_t> data) const {
+    return decodeSource(Source{nullptr, data, nullptr}, m_allocator, m_sample_depth, m_channels, m_target_width, m_target_height);
+}
+
+Image ImageDecoder::decodeImage(Reader& reader) const {
+    ReaderCallbacks callbacks{reader, nullptr};
+    return decodeSource(Source{nullptr, {}, &callbacks}, m_allocator, m_sample_depth, m_channels, m_target_width, m_target_height);
+}
+
+ImageDecoder::Info ImageDecoder::decodeInto(const std::string& filepath, std::span<uint8_t> destination, size_t stride) const {
+    if (m_input_mode == InputMode::MemoryMapped && MappedFile::isSupported()) {
+        MappedFile file(filepath);
+        return decodeSourceInto(Source{&filepath, file.getData(), nullptr}, m_allocator, m_sample_depth, m_channels, m_target_width, m_target_height, destination, stride);
+    }
+    return decodeSourceInto(Source{&filepath, {}, nullptr}, m_allocator, m_sample_depth, m_channels, m_target_width, m_target_height, destination, stride);
+}
+
+ImageDecoder::Info ImageDecoder::decodeInto(std::span<const uint8_t> data, std::span<uint8_t> destination, size_t stride) const {
+    return decodeSourceInto(Source{nullptr, data, nullptr}, m_allocator, m_sample_depth, m_channels, m_target_width, m_target_height, destination, stride);
+}
+
+ImageDecoder::Info ImageDecoder::decodeInto(Reader& reader, std::span<uint8_t> destination, size_t stride) const {
+    ReaderCallbacks callbacks{reader, nullptr};
+    return decodeSourceInto(Source{nullptr, {}, &callbacks}, m_allocator, m_sample_depth, m_channels, m_target_width, m_target_height, destination, stride);
+}
+
+ImageDecoder::Info ImageDecoder::probe(const std::string& filepath) const {
+    FILE* file = std::fopen(filepath.c_str(), "rb");
+    if (! file) {
+        throw std::runtime_error(std::string("Failed to open image at ") + filepath);
+    }
+
+    Info info;
+    bool recognized = stbi_info_from_file(file, &info.width, &info.height, &info.channels) != 0;
+    if (recognized) {
+        probeFileSampleDepth(file, info.isHDR, info.is16Bit);
+
+        uint8_t signature[SIGNATURE_SIZE];
+        size_t signature_size = std::fread(signature, 1, sizeof(signature), file);
+        info.format = detectFormat(signature, signature_size);
+    }
+    std::fclose(file);
+
+    if (! recognized) {
+        throw std::runtime_error(std::string("Failed to probe image at ") + filepath);
+    }
+    return info;
+}
+
+ImageDecoder::Info ImageDecoder::probe(std::span<const uint8_t> data) const {
+    int size = checkedBufferSize(data, "Failed to probe image");
+
+    Info info;
+    if (! stbi_info_from_memory(data.data(), size, &info.width, &info.height, &info.channels)) {
+        throw std::runtime_error("Failed to probe image from memory");
+    }
+    info.is16Bit = stbi_is_16_bit_from_memory(data.data(), size) != 0;
+    info.isHDR = stbi_is_hdr_from_memory(data.data(), size) != 0;
+    info.format = detectFormat(data.data(), data.size());
+
+    return info;
+}
+
+std::vector<ImageDecoder::BatchResult> ImageDecoder::decodeBatch(std::span<const std::string> filepaths, size_t concurrency, const ProgressCallback& progress) const {
+    auto decodeItem = [&](size_t index, BatchResult& result) {
+        // Pin the per-thread stb_image flags so that process-wide settings changed elsewhere
+        // cannot alter the output of the workers midway through the batch. The setters are sticky,
+        // which is fine on the batch's own worker threads.
+        stbi_set_flip_vertically_on_load_thread(0);
+        stbi_set_unpremultiply_on_load_thread(0);
+        stbi_convert_iphone_png_to_rgb_thread(0);
+
+        result.image = decodeImage(filepaths[index]);
+    };
+    return runBatch<BatchResult>(filepaths.size(), concurrency, decodeItem, progress);
+}
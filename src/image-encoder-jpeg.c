@@ -1,13 +1,329 @@
 #include "image-encoder-jpeg.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <setjmp.h>
 #include <jpeglib.h>
+#include <jerror.h>
 
-bool encodeImageToJPEG(const uint8_t* buffer, int width, int height, int number_of_channels, const char* filename) {
-    
-    // Validate the number of channels. JPEG typically supports 3 (RGB) or 1 (grayscale) channels.
-    if (number_of_channels != 3 && number_of_channels != 1) {
-        return false; // Unsupported channel count for JPEG.
+#include "image-jpeg-common.h"
+
+// Size of the staging buffers used when writing to a file or a sink.
+#define STAGING_BUFFER_SIZE 65536
+
+// Maximum number of row pointers handed to jpeg_write_scanlines at once.
+#define ROW_BATCH_SIZE 16
+
+// Destination manager that appends the compressed data to an in-memory sink through a staging buffer.
+struct SinkDestination {
+    struct jpeg_destination_mgr base;
+    ImageEncoderSink* sink;
+    JOCTET buffer[STAGING_BUFFER_SIZE];
+};
+
+// Destination manager that writes the compressed data to a file through a staging buffer.
+struct FileDestination {
+    struct jpeg_destination_mgr base;
+    FILE* fp;
+    JOCTET buffer[STAGING_BUFFER_SIZE];
+};
+
+struct JPEGEncoder {
+    struct jpeg_compress_struct cinfo;
+    struct JPEGErrorManager error_manager;
+    struct SinkDestination sink_destination;
+    struct FileDestination file_destination;
+    int configured_channels;                // Channel count the compression parameters were set up for, 0 if none.
+    JPEGEncoderOptions configured_options;  // Options the compression parameters were set up for.
+    int input_channels;                     // Channel count of the rows of the encode in progress, including alpha.
+    JPEGAlphaMode alpha_mode;               // Alpha handling of the encode in progress.
+    uint8_t background[3];                  // Background color of the encode in progress.
+    JSAMPLE* row_buffer;                    // Row with alpha removed, handed to libjpeg.
+    size_t row_buffer_size;                 // Size of the row buffer in bytes.
+    bool used;                              // Whether the compression object has compressed an image.
+    bool active;                            // Whether an encode is in progress.
+};
+
+static void initSinkDestination(j_compress_ptr cinfo) {
+    struct SinkDestination* destination = (struct SinkDestination*)cinfo->dest;
+    destination->base.next_output_byte = destination->buffer;
+    destination->base.free_in_buffer = STAGING_BUFFER_SIZE;
+}
+
+// Called by libjpeg when the staging buffer is full: append it to the sink and start over.
+static boolean emptySinkDestination(j_compress_ptr cinfo) {
+    struct SinkDestination* destination = (struct SinkDestination*)cinfo->dest;
+    if (!imageEncoderSinkWrite(destination->sink, destination->buffer, STAGING_BUFFER_SIZE)) {
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+    destination->base.next_output_byte = destination->buffer;
+    destination->base.free_in_buffer = STAGING_BUFFER_SIZE;
+
+    return TRUE;
+}
+
+static void termSinkDestination(j_compress_ptr cinfo) {
+    struct SinkDestination* destination = (struct SinkDestination*)cinfo->dest;
+    size_t length = STAGING_BUFFER_SIZE - destination->base.free_in_buffer;
+    if (!imageEncoderSinkWrite(destination->sink, destination->buffer, length)) {
+        ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    }
+}
+
+static void initFileDestination(j_compress_ptr cinfo) {
+    struct FileDestination* destination = (struct FileDestination*)cinfo->dest;
+    destination->base.next_output_byte = destination->buffer;
+    destination->base.free_in_buffer = STAGING_BUFFER_SIZE;
+}
+
+static boolean emptyFileDestination(j_compress_ptr cinfo) {
+    struct FileDestination* destination = (struct FileDestination*)cinfo->dest;
+    if (fwrite(destination->buffer, 1, STAGING_BUFFER_SIZE, destination->fp) != STAGING_BUFFER_SIZE) {
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+    destination->base.next_output_byte = destination->buffer;
+    destination->base.free_in_buffer = STAGING_BUFFER_SIZE;
+
+    return TRUE;
+}
+
+static void termFileDestination(j_compress_ptr cinfo) {
+    struct FileDestination* destination = (struct FileDestination*)cinfo->dest;
+    size_t length = STAGING_BUFFER_SIZE - destination->base.free_in_buffer;
+    if (length > 0 && fwrite(destination->buffer, 1, length, destination->fp) != length) {
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+    if (fflush(destination->fp) != 0) {
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+}
+
+// Creates the JPEG compression object, reporting a failure instead of terminating the process.
+static bool createCompressObject(JPEGEncoder* encoder) {
+    encoder->cinfo.err = initJPEGErrorManager(&encoder->error_manager);
+    if (setjmp(encoder->error_manager.jump_buffer)) {
+        return false;
+    }
+    jpeg_create_compress(&encoder->cinfo);
+
+    return true;
+}
+
+JPEGEncoder* createJPEGEncoder(void) {
+    JPEGEncoder* encoder = (JPEGEncoder*)malloc(sizeof(JPEGEncoder));
+    if (!encoder) {
+        return NULL;
+    }
+
+    // Create the JPEG compression object once; it is reused for every image.
+    if (!createCompressObject(encoder)) {
+        free(encoder);
+        return NULL;
+    }
+
+    encoder->sink_destination.base.init_destination = initSinkDestination;
+    encoder->sink_destination.base.empty_output_buffer = emptySinkDestination;
+    encoder->sink_destination.base.term_destination = termSinkDestination;
+    encoder->sink_destination.sink = NULL;
+
+    encoder->file_destination.base.init_destination = initFileDestination;
+    encoder->file_destination.base.empty_output_buffer = emptyFileDestination;
+    encoder->file_destination.base.term_destination = termFileDestination;
+    encoder->file_destination.fp = NULL;
+
+    encoder->configured_channels = 0;
+    encoder->row_buffer = NULL;
+    encoder->row_buffer_size = 0;
+    encoder->used = false;
+    encoder->active = false;
+
+    return encoder;
+}
+
+void destroyJPEGEncoder(JPEGEncoder* encoder) {
+    if (!encoder) {
+        return;
+    }
+    abortJPEGEncode(encoder);
+    jpeg_destroy_compress(&encoder->cinfo);
+    free(encoder->row_buffer);
+    free(encoder);
+}
+
+static bool sameOptions(const JPEGEncoderOptions* a, const JPEGEncoderOptions* b) {
+    return a->quality == b->quality
+        && a->subsampling == b->subsampling
+        && a->optimize_coding == b->optimize_coding
+        && a->progressive == b->progressive
+        && a->dct_method == b->dct_method;
+}
+
+// Sets up the compression parameters for the color space already stored in `cinfo`.
+static void configure(struct jpeg_compress_struct* cinfo, const JPEGEncoderOptions* options) {
+    jpeg_set_defaults(cinfo);
+    jpeg_set_quality(cinfo, options->quality, TRUE);
+
+    // Luma sampling factors relative to the chroma components, which always sample at 1x1.
+    if (cinfo->num_components == 3) {
+        int horizontal = options->subsampling == JPEG_SUBSAMPLING_444 ? 1 : 2;
+        int vertical = options->subsampling == JPEG_SUBSAMPLING_420 ? 2 : 1;
+        cinfo->comp_info[0].h_samp_factor = horizontal;
+        cinfo->comp_info[0].v_samp_factor = vertical;
+        cinfo->comp_info[1].h_samp_factor = cinfo->comp_info[1].v_samp_factor = 1;
+        cinfo->comp_info[2].h_samp_factor = cinfo->comp_info[2].v_samp_factor = 1;
+    }
+
+    cinfo->optimize_coding = options->optimize_coding ? TRUE : FALSE;
+    switch (options->dct_method) {
+    case JPEG_DCT_METHOD_IFAST:
+        cinfo->dct_method = JDCT_IFAST;
+        break;
+    case JPEG_DCT_METHOD_FLOAT:
+        cinfo->dct_method = JDCT_FLOAT;
+        break;
+    default:
+        cinfo->dct_method = JDCT_ISLOW;
+        break;
+    }
+
+    if (options->progressive) {
+        jpeg_simple_progression(cinfo);
+    }
+}
+
+// Ends the encode in progress, if any, and closes the output file. When `success` is false the
+// compression is aborted, which keeps the compression object reusable, but the parameters are set
+// up again for the next image to be safe. Returns false if the encode did not end cleanly.
+static bool endEncode(JPEGEncoder* encoder, bool success) {
+    if (!success) {
+        if (encoder->active) {
+            jpeg_abort_compress(&encoder->cinfo);
+        }
+        encoder->configured_channels = 0;
+    }
+    encoder->active = false;
+
+    if (encoder->file_destination.fp) {
+        if (fclose(encoder->file_destination.fp) != 0) {
+            success = false;
+        }
+        encoder->file_destination.fp = NULL;
+    }
+    encoder->sink_destination.sink = NULL;
+
+    return success;
+}
+
+// Removes the alpha channel from a row of gray-alpha or RGBA pixels, either dropping it or blending
+// the pixels over the background.
+static void removeAlpha(const JPEGEncoder* encoder, const uint8_t* row, JSAMPLE* output, JDIMENSION width) {
+    const int color_channels = encoder->input_channels - 1;
+    uint8_t background[3];
+    if (color_channels == 1) {
+        // BT.601 luma, matching libjpeg's RGB to grayscale conversion.
+        background[0] = (uint8_t)((77 * encoder->background[0] + 150 * encoder->background[1] + 29 * encoder->background[2] + 128) >> 8);
+    } else {
+        background[0] = encoder->background[0];
+        background[1] = encoder->background[1];
+        background[2] = encoder->background[2];
+    }
+
+    if (encoder->alpha_mode == JPEG_ALPHA_STRIP) {
+        for (JDIMENSION x = 0; x < width; x++, row += encoder->input_channels, output += color_channels) {
+            for (int c = 0; c < color_channels; c++) {
+                output[c] = row[c];
+            }
+        }
+        return;
+    }
+
+    for (JDIMENSION x = 0; x < width; x++, row += encoder->input_channels, output += color_channels) {
+        unsigned alpha = row[color_channels];
+        for (int c = 0; c < color_channels; c++) {
+            output[c] = divideBy255(row[c] * alpha + background[c] * (255 - alpha));
+        }
+    }
+}
+
+// Starts encoding an image into the destination manager currently installed on the encoder.
+static bool beginEncode(JPEGEncoder* encoder, int width, int height, int number_of_channels, const JPEGEncoderOptions* options) {
+
+    // Validate the number of channels. Alpha is removed while writing, so JPEG itself stores 3 (RGB)
+    // or 1 (grayscale) channels.
+    if (number_of_channels < 1 || number_of_channels > 4) {
+        return endEncode(encoder, false); // Unsupported channel count for JPEG.
+    }
+    const int color_channels = number_of_channels >= 3 ? 3 : 1;
+
+    // Images with alpha go through a single row buffer, reused across encodes.
+    if (color_channels != number_of_channels) {
+        size_t row_size = (size_t)width * color_channels;
+        if (row_size > encoder->row_buffer_size) {
+            JSAMPLE* row_buffer = (JSAMPLE*)realloc(encoder->row_buffer, row_size);
+            if (!row_buffer) {
+                return endEncode(encoder, false);
+            }
+            encoder->row_buffer = row_buffer;
+            encoder->row_buffer_size = row_size;
+        }
+    }
+    encoder->input_channels = number_of_channels;
+    encoder->alpha_mode = options->alpha_mode;
+    encoder->background[0] = options->background[0];
+    encoder->background[1] = options->background[1];
+    encoder->background[2] = options->background[2];
+
+    struct jpeg_compress_struct* cinfo = &encoder->cinfo;
+
+    // Set up error handling with setjmp/longjmp.
+    if (setjmp(encoder->error_manager.jump_buffer)) {
+        return endEncode(encoder, false);
+    }
+
+    // Compression parameters survive between images, so the tables only need to be rebuilt when
+    // the color space or the options change.
+    bool reconfigure = encoder->configured_channels != color_channels || !sameOptions(&encoder->configured_options, options);
+
+    // jpeg_set_defaults doesn't replace Huffman tables that already exist, and optimized or
+    // progressive coding overwrites them with tables fitted to the last image, so start over with
+    // a fresh compression object once it has been used.
+    if (reconfigure && encoder->used) {
+        struct jpeg_destination_mgr* destination = cinfo->dest;
+        jpeg_destroy_compress(cinfo);
+        jpeg_create_compress(cinfo);
+        cinfo->dest = destination;
+        encoder->used = false;
+    }
+
+    // Set image properties.
+    cinfo->image_width = width;
+    cinfo->image_height = height;
+    cinfo->input_components = color_channels;
+    cinfo->in_color_space = (color_channels == 3) ? JCS_RGB : JCS_GRAYSCALE;
+
+    // Set compression parameters.
+    if (reconfigure) {
+        configure(cinfo, options);
+        encoder->configured_channels = color_channels;
+        encoder->configured_options = *options;
+    }
+
+    // Start compression.
+    encoder->used = true;
+    encoder->active = true;
+    jpeg_start_compress(cinfo, TRUE);
+
+    return true;
+}
+
+bool beginJPEGEncode(JPEGEncoder* encoder, int width, int height, int number_of_channels, const JPEGEncoderOptions* options, const char* filename) {
+
+    // Finish off any encode that was left in progress.
+    abortJPEGEncode(encoder);
+
+    // Validate the number of channels before creating the file.
+    if (number_of_channels < 1 || number_of_channels > 4) {
+        return false;
     }
 
     // Open the file for writing in binary mode.
@@ -16,40 +332,93 @@ bool encodeImageToJPEG(const uint8_t* buffer, int width, int height, int number_
         return false;
     }
 
-    // Create a JPEG compression object.
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    cinfo.err = jpeg_std_error(&jerr);
-    jpeg_create_compress(&cinfo);
+    encoder->file_destination.fp = fp;
+    encoder->cinfo.dest = &encoder->file_destination.base;
 
-    // Set the output file for compression.
-    jpeg_stdio_dest(&cinfo, fp);
+    return beginEncode(encoder, width, height, number_of_channels, options);
+}
 
-    // Set image properties.
-    cinfo.image_width = width;
-    cinfo.image_height = height;
-    cinfo.input_components = number_of_channels;
-    cinfo.in_color_space = (number_of_channels == 3) ? JCS_RGB : JCS_GRAYSCALE;
+bool beginJPEGEncodeToSink(JPEGEncoder* encoder, int width, int height, int number_of_channels, const JPEGEncoderOptions* options, ImageEncoderSink* sink) {
 
-    // Set default compression parameters.
-    jpeg_set_defaults(&cinfo);
-    jpeg_set_quality(&cinfo, 85, TRUE); // Set JPEG quality (0-100).
+    // Finish off any encode that was left in progress.
+    abortJPEGEncode(encoder);
 
-    // Start compression.
-    jpeg_start_compress(&cinfo, TRUE);
+    encoder->sink_destination.sink = sink;
+    encoder->cinfo.dest = &encoder->sink_destination.base;
+
+    return beginEncode(encoder, width, height, number_of_channels, options);
+}
 
-    // Write the image data row by row.
-    while (cinfo.next_scanline < cinfo.image_height) {
-        JSAMPROW row_pointer = (JSAMPROW)(buffer + cinfo.next_scanline * width * number_of_channels);
-        jpeg_write_scanlines(&cinfo, &row_pointer, 1);
+bool writeJPEGRows(JPEGEncoder* encoder, const uint8_t* rows, int count, size_t stride) {
+    if (!encoder->active) {
+        return false;
     }
 
-    // Finish compression.
-    jpeg_finish_compress(&cinfo);
+    struct jpeg_compress_struct* cinfo = &encoder->cinfo;
+    if (count < 0 || (JDIMENSION)count > cinfo->image_height - cinfo->next_scanline) {
+        return endEncode(encoder, false);
+    }
+    const size_t row_stride = stride ? stride : (size_t)cinfo->image_width * encoder->input_channels;
+
+    // Set up error handling with setjmp/longjmp.
+    if (setjmp(encoder->error_manager.jump_buffer)) {
+        return endEncode(encoder, false);
+    }
 
-    // Clean up and close the file.
-    jpeg_destroy_compress(&cinfo);
-    fclose(fp);
+    // Rows with alpha are converted into the row buffer one at a time, just before libjpeg reads them.
+    if (encoder->input_channels != cinfo->input_components) {
+        JSAMPROW row_pointer = encoder->row_buffer;
+        for (int i = 0; i < count; i++) {
+            removeAlpha(encoder, rows + (size_t)i * row_stride, encoder->row_buffer, cinfo->image_width);
+            jpeg_write_scanlines(cinfo, &row_pointer, 1);
+        }
+        return true;
+    }
+
+    // Write the image data, handing libjpeg a batch of row pointers at a time.
+    JSAMPROW row_pointers[ROW_BATCH_SIZE];
+    int written = 0;
+    while (written < count) {
+        int batch = count - written < ROW_BATCH_SIZE ? count - written : ROW_BATCH_SIZE;
+        for (int i = 0; i < batch; i++) {
+            row_pointers[i] = (JSAMPROW)(rows + (size_t)(written + i) * row_stride);
+        }
+        written += (int)jpeg_write_scanlines(cinfo, row_pointers, (JDIMENSION)batch);
+    }
 
     return true;
 }
+
+bool finishJPEGEncode(JPEGEncoder* encoder) {
+    if (!encoder->active) {
+        return false;
+    }
+
+    // libjpeg reports an error if fewer rows than the image height were written.
+    if (setjmp(encoder->error_manager.jump_buffer)) {
+        return endEncode(encoder, false);
+    }
+
+    // Finish compression. The compression object is left ready for the next image.
+    jpeg_finish_compress(&encoder->cinfo);
+
+    return endEncode(encoder, true);
+}
+
+void abortJPEGEncode(JPEGEncoder* encoder) {
+    if (encoder->active) {
+        endEncode(encoder, false);
+    }
+}
+
+bool encodeImageToJPEG(JPEGEncoder* encoder, const uint8_t* buffer, int width, int height, int number_of_channels, size_t stride, const JPEGEncoderOptions* options, const char* filename) {
+    return beginJPEGEncode(encoder, width, height, number_of_channels, options, filename)
+        && writeJPEGRows(encoder, buffer, height, stride)
+        && finishJPEGEncode(encoder);
+}
+
+bool encodeImageToJPEGSink(JPEGEncoder* encoder, const uint8_t* buffer, int width, int height, int number_of_channels, size_t stride, const JPEGEncoderOptions* options, ImageEncoderSink* sink) {
+    return beginJPEGEncodeToSink(encoder, width, height, number_of_channels, options, sink)
+        && writeJPEGRows(encoder, buffer, height, stride)
+        && finishJPEGEncode(encoder);
+}
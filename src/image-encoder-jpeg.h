@@ -2,4 +2,78 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-bool encodeImageToJPEG(const uint8_t* buffer, int width, int height, int number_of_channels, const char* filename);
+#include "image-encoder-sink.h"
+
+/**
+ * Chroma subsampling applied to color images.
+ */
+typedef enum JPEGSubsampling {
+    JPEG_SUBSAMPLING_444 = 0,
+    JPEG_SUBSAMPLING_422 = 1,
+    JPEG_SUBSAMPLING_420 = 2
+} JPEGSubsampling;
+
+/**
+ * Forward DCT implementation.
+ */
+typedef enum JPEGDCTMethod {
+    JPEG_DCT_METHOD_ISLOW = 0,
+    JPEG_DCT_METHOD_IFAST = 1,
+    JPEG_DCT_METHOD_FLOAT = 2
+} JPEGDCTMethod;
+
+/**
+ * Handling of the alpha channel of gray-alpha and RGBA images, which JPEG cannot store.
+ */
+typedef enum JPEGAlphaMode {
+    JPEG_ALPHA_STRIP = 0,       // Drop alpha and keep the color values as they are.
+    JPEG_ALPHA_COMPOSITE = 1    // Blend the pixels over the background color.
+} JPEGAlphaMode;
+
+/**
+ * Compression parameters for a JPEG encode.
+ */
+typedef struct JPEGEncoderOptions {
+    int quality;                    // Quality from 0 to 100.
+    JPEGSubsampling subsampling;    // Chroma subsampling for color images.
+    bool optimize_coding;           // Whether to compute optimal Huffman tables (slower, smaller).
+    bool progressive;               // Whether to write a progressive JPEG.
+    JPEGDCTMethod dct_method;       // Forward DCT implementation.
+    JPEGAlphaMode alpha_mode;       // Handling of the alpha channel of 2 and 4 channel images.
+    uint8_t background[3];          // RGB background color for JPEG_ALPHA_COMPOSITE. Gray images use its luma.
+} JPEGEncoderOptions;
+
+/**
+ * Persistent JPEG compression context. The compression object and its quantization and Huffman
+ * tables are created once and reused for every image encoded with the same context.
+ */
+typedef struct JPEGEncoder JPEGEncoder;
+
+JPEGEncoder* createJPEGEncoder(void);
+
+void destroyJPEGEncoder(JPEGEncoder* encoder);
+
+/**
+ * Row-by-row encoding. An encode is started with one of the begin functions, fed with writeJPEGRows
+ * until all rows have been written and completed with finishJPEGEncode. Any failure ends the encode,
+ * after which the context is ready for a new one.
+ *
+ * Images may have 1 (gray), 2 (gray and alpha), 3 (RGB) or 4 (RGBA) channels. Alpha is removed
+ * according to the alpha mode one row at a time, into a row buffer kept by the context.
+ */
+bool beginJPEGEncode(JPEGEncoder* encoder, int width, int height, int number_of_channels, const JPEGEncoderOptions* options, const char* filename);
+
+bool beginJPEGEncodeToSink(JPEGEncoder* encoder, int width, int height, int number_of_channels, const JPEGEncoderOptions* options, ImageEncoderSink* sink);
+
+bool writeJPEGRows(JPEGEncoder* encoder, const uint8_t* rows, int count, size_t stride);
+
+bool finishJPEGEncode(JPEGEncoder* encoder);
+
+void abortJPEGEncode(JPEGEncoder* encoder);
+
+/**
+ * One-shot encoding of a whole image whose rows are stride bytes apart (0 for tightly packed rows).
+ */
+bool encodeImageToJPEG(JPEGEncoder* encoder, const uint8_t* buffer, int width, int height, int number_of_channels, size_t stride, const JPEGEncoderOptions* options, const char* filename);
+
+bool encodeImageToJPEGSink(JPEGEncoder* encoder, const uint8_t* buffer, int width, int height, int number_of_channels, size_t stride, const JPEGEncoderOptions* options, ImageEncoderSink* sink);
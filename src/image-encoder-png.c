@@ -1,10 +1,176 @@
 #include "image-encoder-png.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <png.h>
+#include <zlib.h>
+
+// Maximum number of freed blocks kept for reuse by a context.
+#define CACHED_BLOCK_COUNT 32
+
+// Header placed in front of every block handed to libpng, so its size is known when it is freed.
+typedef union BlockHeader {
+    size_t size;
+    long double alignment_long_double;
+    long long alignment_long_long;
+    void* alignment_pointer;
+} BlockHeader;
+
+struct PNGEncoder {
+    BlockHeader* cached_blocks[CACHED_BLOCK_COUNT];     // Freed blocks available for reuse.
+    int cached_block_count;                             // Number of entries in cached_blocks.
+
+    // State of the image being encoded, if any.
+    png_structp png;                                    // Write struct, NULL when no encode is in progress.
+    png_infop info;                                     // Info struct of the image.
+    FILE* fp;                                           // Output file, NULL when writing to a sink.
+    int height;                                         // Height of the image in pixels.
+    int rows_written;                                   // Number of rows written so far.
+    size_t row_size;                                    // Size of a packed row in bytes.
+};
+
+// libpng allocation callback. Serves the request from the context's cache when a block of the same
+// size was freed by a previous image, which is the common case for the zlib and row buffers.
+static png_voidp allocateBlock(png_structp png, png_alloc_size_t size) {
+    PNGEncoder* encoder = (PNGEncoder*)png_get_mem_ptr(png);
+
+    for (int i = encoder->cached_block_count - 1; i >= 0; i--) {
+        BlockHeader* block = encoder->cached_blocks[i];
+        if (block->size == size) {
+            encoder->cached_blocks[i] = encoder->cached_blocks[--encoder->cached_block_count];
+            return block + 1;
+        }
+    }
+
+    BlockHeader* block = (BlockHeader*)malloc(sizeof(BlockHeader) + size);
+    if (!block) {
+        return NULL;
+    }
+    block->size = size;
+    return block + 1;
+}
+
+// libpng deallocation callback. Keeps the block for reuse unless the cache is full.
+static void freeBlock(png_structp png, png_voidp pointer) {
+    if (!pointer) {
+        return;
+    }
+
+    PNGEncoder* encoder = (PNGEncoder*)png_get_mem_ptr(png);
+    BlockHeader* block = (BlockHeader*)pointer - 1;
+
+    if (encoder->cached_block_count < CACHED_BLOCK_COUNT) {
+        encoder->cached_blocks[encoder->cached_block_count++] = block;
+    } else {
+        free(block);
+    }
+}
+
+// libpng write callback that appends the compressed bytes to an in-memory sink.
+static void writeToSink(png_structp png, png_bytep data, png_size_t length) {
+    ImageEncoderSink* sink = (ImageEncoderSink*)png_get_io_ptr(png);
+    if (!imageEncoderSinkWrite(sink, data, length)) {
+        png_error(png, "Failed to grow the output buffer");
+    }
+}
+
+// Nothing to flush for an in-memory sink.
+static void flushSink(png_structp png) {
+    (void)png;
+}
+
+PNGEncoder* createPNGEncoder(void) {
+    PNGEncoder* encoder = (PNGEncoder*)malloc(sizeof(PNGEncoder));
+    if (!encoder) {
+        return NULL;
+    }
+    encoder->cached_block_count = 0;
+    encoder->png = NULL;
+    encoder->info = NULL;
+    encoder->fp = NULL;
+
+    return encoder;
+}
+
+void destroyPNGEncoder(PNGEncoder* encoder) {
+    if (!encoder) {
+        return;
+    }
+    abortPNGEncode(encoder);
+    for (int i = 0; i < encoder->cached_block_count; i++) {
+        free(encoder->cached_blocks[i]);
+    }
+    free(encoder);
+}
+
+// Applies the compression parameters to a freshly created png_struct.
+static void configure(png_structp png, const PNGEncoderOptions* options) {
+    png_set_compression_level(png, options->compression_level);
+
+    switch (options->strategy) {
+    case PNG_STRATEGY_FILTERED:
+        png_set_compression_strategy(png, Z_FILTERED);
+        break;
+    case PNG_STRATEGY_HUFFMAN_ONLY:
+        png_set_compression_strategy(png, Z_HUFFMAN_ONLY);
+        break;
+    case PNG_STRATEGY_RLE:
+        png_set_compression_strategy(png, Z_RLE);
+        break;
+    case PNG_STRATEGY_FIXED:
+        png_set_compression_strategy(png, Z_FIXED);
+        break;
+    default:
+        break;
+    }
+
+    int filters = 0;
+    if (options->row_filters & PNG_ROW_FILTER_NONE) {
+        filters |= PNG_FILTER_NONE;
+    }
+    if (options->row_filters & PNG_ROW_FILTER_SUB) {
+        filters |= PNG_FILTER_SUB;
+    }
+    if (options->row_filters & PNG_ROW_FILTER_UP) {
+        filters |= PNG_FILTER_UP;
+    }
+    if (options->row_filters & PNG_ROW_FILTER_AVERAGE) {
+        filters |= PNG_FILTER_AVG;
+    }
+    if (options->row_filters & PNG_ROW_FILTER_PAETH) {
+        filters |= PNG_FILTER_PAETH;
+    }
+    png_set_filter(png, PNG_FILTER_TYPE_BASE, filters ? filters : PNG_FILTER_NONE);
+
+    png_set_compression_buffer_size(png, options->buffer_size);
+}
+
+// Releases the state of the image being encoded and closes the output file, if any.
+// Returns false if the file could not be closed cleanly.
+static bool endEncode(PNGEncoder* encoder) {
+    bool success = true;
+
+    if (encoder->png) {
+        png_destroy_write_struct(&encoder->png, &encoder->info);
+        encoder->png = NULL;
+        encoder->info = NULL;
+    }
+    if (encoder->fp) {
+        success = fclose(encoder->fp) == 0;
+        encoder->fp = NULL;
+    }
+
+    return success;
+}
+
+// Starts encoding an image into either the file `fp` or, if `fp` is NULL, the in-memory `sink`.
+// Takes ownership of `fp`.
+static bool beginEncode(PNGEncoder* encoder, int width, int height, int number_of_channels, int bit_depth, const PNGEncoderOptions* options, FILE* fp, ImageEncoderSink* sink) {
+
+    // Finish off any encode that was left in progress.
+    abortPNGEncode(encoder);
+    encoder->fp = fp;
 
-bool encodeImageToPNG(const uint8_t* buffer, int width, int height, int number_of_channels, const char* filename) {
-    
     // Determine PNG color type macro.
     int png_color_type;
     switch (number_of_channels) {
@@ -23,65 +189,150 @@ bool encodeImageToPNG(const uint8_t* buffer, int width, int height, int number_o
     default:
 
         // Invalid number of color channels.
+        endEncode(encoder);
         return false;
     }
-
-    // Open the file for writing in binary mode.
-    FILE* fp = fopen(filename, "wb");
-    if (!fp) {
+    if (bit_depth != 8 && bit_depth != 16) {
+        endEncode(encoder);
         return false;
     }
 
-    // Create and initialize the png_struct.
-    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (!png) {
-        fclose(fp);
+    // Create and initialize the png_struct, with all of its memory coming from the context.
+    encoder->png = png_create_write_struct_2(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL, encoder, allocateBlock, freeBlock);
+    if (!encoder->png) {
+        endEncode(encoder);
         return false;
     }
 
     // Create and initialize the png_info.
-    png_infop info = png_create_info_struct(png);
-    if (!info) {
-        png_destroy_write_struct(&png, NULL);
-        fclose(fp);
+    encoder->info = png_create_info_struct(encoder->png);
+    if (!encoder->info) {
+        endEncode(encoder);
         return false;
     }
 
     // Set up error handling with setjmp/longjmp.
-    if (setjmp(png_jmpbuf(png))) {
-        png_destroy_write_struct(&png, &info);
-        fclose(fp);
+    if (setjmp(png_jmpbuf(encoder->png))) {
+        endEncode(encoder);
         return false;
     }
 
-    // Set the output file.
-    png_init_io(png, fp);
+    // Set the output file or sink.
+    if (fp) {
+        png_init_io(encoder->png, fp);
+    } else {
+        png_set_write_fn(encoder->png, sink, writeToSink, flushSink);
+    }
+
+    // Set the compression parameters.
+    configure(encoder->png, options);
 
     // Set the PNG header information.
     png_set_IHDR(
-        png, info, width, height,
-        8,                                  // Bit depth.
+        encoder->png, encoder->info, width, height,
+        bit_depth,                          // Bit depth.
         png_color_type,                     // Color type.
         PNG_INTERLACE_NONE,                 // Interlace method.
         PNG_COMPRESSION_TYPE_DEFAULT,       // Compression method.
         PNG_FILTER_TYPE_DEFAULT             // Filter method.
     );
 
-    // Write the header information to the file.
-    png_write_info(png, info);
+    // Write the header information to the output.
+    png_write_info(encoder->png, encoder->info);
 
-    // Write the image data.
-    for (int y = 0; y < height; y++) {
-        png_bytep row_pointer = (png_bytep)(buffer + y * width * number_of_channels);
-        png_write_row(png, row_pointer);
+    // PNG stores 16-bit samples big-endian, while the rows come in host byte order.
+    const uint16_t byte_order = 1;
+    if (bit_depth == 16 && *(const uint8_t*)&byte_order == 1) {
+        png_set_swap(encoder->png);
     }
 
-    // Finish writing the file.
-    png_write_end(png, NULL);
+    encoder->height = height;
+    encoder->rows_written = 0;
+    encoder->row_size = (size_t)width * number_of_channels * (bit_depth / 8);
 
-    // Clean up.
-    png_destroy_write_struct(&png, &info);
-    fclose(fp);
+    return true;
+}
+
+bool beginPNGEncode(PNGEncoder* encoder, int width, int height, int number_of_channels, int bit_depth, const PNGEncoderOptions* options, const char* filename) {
+
+    // Validate the number of channels and the bit depth before creating the file.
+    if (number_of_channels < 1 || number_of_channels > 4 || (bit_depth != 8 && bit_depth != 16)) {
+        return false;
+    }
+
+    // Open the file for writing in binary mode.
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    return beginEncode(encoder, width, height, number_of_channels, bit_depth, options, fp, NULL);
+}
+
+bool beginPNGEncodeToSink(PNGEncoder* encoder, int width, int height, int number_of_channels, int bit_depth, const PNGEncoderOptions* options, ImageEncoderSink* sink) {
+    return beginEncode(encoder, width, height, number_of_channels, bit_depth, options, NULL, sink);
+}
+
+bool writePNGRows(PNGEncoder* encoder, const uint8_t* rows, int count, size_t stride) {
+    if (!encoder->png) {
+        return false;
+    }
+    if (count < 0 || count > encoder->height - encoder->rows_written) {
+        endEncode(encoder);
+        return false;
+    }
+    const size_t row_stride = stride ? stride : encoder->row_size;
+
+    // Set up error handling with setjmp/longjmp.
+    if (setjmp(png_jmpbuf(encoder->png))) {
+        endEncode(encoder);
+        return false;
+    }
+
+    // Write the image data.
+    for (int y = 0; y < count; y++) {
+        png_bytep row_pointer = (png_bytep)(rows + (size_t)y * row_stride);
+        png_write_row(encoder->png, row_pointer);
+    }
+    encoder->rows_written += count;
 
     return true;
 }
+
+bool finishPNGEncode(PNGEncoder* encoder) {
+    if (!encoder->png) {
+        return false;
+    }
+    if (encoder->rows_written != encoder->height) {
+        endEncode(encoder);
+        return false;
+    }
+
+    // Set up error handling with setjmp/longjmp.
+    if (setjmp(png_jmpbuf(encoder->png))) {
+        endEncode(encoder);
+        return false;
+    }
+
+    // Finish writing the image.
+    png_write_end(encoder->png, NULL);
+
+    // Clean up. The memory goes back to the context's cache.
+    return endEncode(encoder);
+}
+
+void abortPNGEncode(PNGEncoder* encoder) {
+    endEncode(encoder);
+}
+
+bool encodeImageToPNG(PNGEncoder* encoder, const uint8_t* buffer, int width, int height, int number_of_channels, int bit_depth, size_t stride, const PNGEncoderOptions* options, const char* filename) {
+    return beginPNGEncode(encoder, width, height, number_of_channels, bit_depth, options, filename)
+        && writePNGRows(encoder, buffer, height, stride)
+        && finishPNGEncode(encoder);
+}
+
+bool encodeImageToPNGSink(PNGEncoder* encoder, const uint8_t* buffer, int width, int height, int number_of_channels, int bit_depth, size_t stride, const PNGEncoderOptions* options, ImageEncoderSink* sink) {
+    return beginPNGEncodeToSink(encoder, width, height, number_of_channels, bit_depth, options, sink)
+        && writePNGRows(encoder, buffer, height, stride)
+        && finishPNGEncode(encoder);
+}
@@ -3,4 +3,70 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-bool encodeImageToPNG(const uint8_t* rgbBuffer, int width, int height, int number_of_channels, const char* filename);
+#include "image-encoder-sink.h"
+
+/**
+ * zlib compression strategy.
+ */
+typedef enum PNGStrategy {
+    PNG_STRATEGY_DEFAULT = 0,       // Let libpng pick based on the row filters in use.
+    PNG_STRATEGY_FILTERED = 1,
+    PNG_STRATEGY_HUFFMAN_ONLY = 2,
+    PNG_STRATEGY_RLE = 3,
+    PNG_STRATEGY_FIXED = 4
+} PNGStrategy;
+
+/**
+ * Row filters, combined as a bit mask.
+ */
+typedef enum PNGRowFilter {
+    PNG_ROW_FILTER_NONE = 1 << 0,
+    PNG_ROW_FILTER_SUB = 1 << 1,
+    PNG_ROW_FILTER_UP = 1 << 2,
+    PNG_ROW_FILTER_AVERAGE = 1 << 3,
+    PNG_ROW_FILTER_PAETH = 1 << 4
+} PNGRowFilter;
+
+/**
+ * Compression parameters for a PNG encode.
+ */
+typedef struct PNGEncoderOptions {
+    int compression_level;      // zlib level from 0 to 9, or -1 for zlib's default.
+    PNGStrategy strategy;       // zlib compression strategy.
+    unsigned int row_filters;   // Allowed row filters (PNGRowFilter mask). libpng picks per row among them.
+    size_t buffer_size;         // Size of the zlib output buffer in bytes.
+} PNGEncoderOptions;
+
+/**
+ * Persistent PNG compression context. libpng cannot reset a png_struct for another image, so a
+ * fresh one is created per image, but all of its memory (including the zlib workspace) is served
+ * from a cache owned by the context and stays warm between images.
+ */
+typedef struct PNGEncoder PNGEncoder;
+
+PNGEncoder* createPNGEncoder(void);
+
+void destroyPNGEncoder(PNGEncoder* encoder);
+
+/**
+ * Row-by-row encoding. An encode is started with one of the begin functions, fed with writePNGRows
+ * until all rows have been written and completed with finishPNGEncode. Any failure ends the encode,
+ * after which the context is ready for a new one.
+ */
+bool beginPNGEncode(PNGEncoder* encoder, int width, int height, int number_of_channels, int bit_depth, const PNGEncoderOptions* options, const char* filename);
+
+bool beginPNGEncodeToSink(PNGEncoder* encoder, int width, int height, int number_of_channels, int bit_depth, const PNGEncoderOptions* options, ImageEncoderSink* sink);
+
+bool writePNGRows(PNGEncoder* encoder, const uint8_t* rows, int count, size_t stride);
+
+bool finishPNGEncode(PNGEncoder* encoder);
+
+void abortPNGEncode(PNGEncoder* encoder);
+
+/**
+ * One-shot encoding of a whole image whose rows are stride bytes apart (0 for tightly packed rows).
+ * The bit depth is 8 or 16; 16-bit samples are passed in host byte order.
+ */
+bool encodeImageToPNG(PNGEncoder* encoder, const uint8_t* rgbBuffer, int width, int height, int number_of_channels, int bit_depth, size_t stride, const PNGEncoderOptions* options, const char* filename);
+
+bool encodeImageToPNGSink(PNGEncoder* encoder, const uint8_t* rgbBuffer, int width, int height, int number_of_channels, int bit_depth, size_t stride, const PNGEncoderOptions* options, ImageEncoderSink* sink);
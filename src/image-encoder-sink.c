@@ -0,0 +1,13 @@
+#include "image-encoder-sink.h"
+
+bool imageEncoderSinkWrite(ImageEncoderSink* sink, const uint8_t* bytes, size_t length) {
+    if (length == 0) {
+        return true;
+    }
+    if (!sink->append(sink->context, bytes, length)) {
+        return false;
+    }
+
+    sink->size += length;
+    return true;
+}
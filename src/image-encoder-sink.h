@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Appends `length` bytes to the storage behind a sink.
+ * Returns false if the storage could not be grown.
+ */
+typedef bool (*ImageEncoderSinkAppendFunction)(void* context, const uint8_t* bytes, size_t length);
+
+/**
+ * In-memory output for the encoders. Bytes are handed to `append` as they are produced, so the
+ * storage only ever holds bytes that have been written and nothing is filled ahead of the encoder.
+ * The same storage can be reused across encodes without going through a temporary file.
+ */
+typedef struct ImageEncoderSink {
+    ImageEncoderSinkAppendFunction append;  // Storage append callback.
+    void* context;                          // Opaque pointer passed to the append callback.
+    size_t size;                            // Number of bytes written so far.
+} ImageEncoderSink;
+
+bool imageEncoderSinkWrite(ImageEncoderSink* sink, const uint8_t* bytes, size_t length);
@@ -1,30 +1,470 @@
 #include <stdexcept>
+#include <mutex>
+#include <limits>
 
 #include "image-encoder.h"
+#include "thread-pool.h"
 
 extern "C" {
 #include "image-encoder-png.h"
 #include "image-encoder-jpeg.h"
 }
 
+namespace {
+
+/**
+ * @brief Append callback for an ImageEncoderSink backed by a std::vector. The vector grows
+ * geometrically and only ever holds encoded bytes, so nothing is zero-filled ahead of the encoder.
+ */
+bool appendToVector(void* context, const uint8_t* bytes, size_t length) {
+    auto* vector = static_cast<std::vector<uint8_t>*>(context);
+    try {
+        vector->insert(vector->end(), bytes, bytes + length);
+    } catch (...) {
+        // Exceptions must not unwind through the C encoders.
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Empties a vector and creates a sink appending to it. The emptied vector keeps its capacity,
+ * so a reused vector doesn't reallocate.
+ */
+ImageEncoderSink makeVectorSink(std::vector<uint8_t>& output) {
+    output.clear();
+
+    ImageEncoderSink sink;
+    sink.append = appendToVector;
+    sink.context = &output;
+    sink.size = 0;
+    return sink;
+}
+
+/**
+ * @brief Retrieves the PNG bit depth for a sample type. Throws if PNG cannot store the samples.
+ */
+int pngBitDepth(Image::SampleType sample_type) {
+    switch (sample_type) {
+    case Image::SampleType::U8:
+        return 8;
+    case Image::SampleType::U16:
+        return 16;
+    default:
+        throw std::invalid_argument("PNG: Only 8-bit and 16-bit samples can be encoded");
+    }
+}
+
+/**
+ * @brief Throws if JPEG cannot store samples of the specified type.
+ */
+void checkJPEGSampleType(Image::SampleType sample_type) {
+    if (sample_type != Image::SampleType::U8) {
+        throw std::invalid_argument("JPEG: Only 8-bit samples can be encoded");
+    }
+}
+
+/**
+ * @brief Converts the public JPEG options to the C encoder's representation.
+ */
+JPEGEncoderOptions toEncoderOptions(const ImageEncoder::JPEGOptions& options) {
+    JPEGEncoderOptions encoder_options;
+    encoder_options.quality = options.quality;
+    encoder_options.optimize_coding = options.optimizeCoding;
+    encoder_options.progressive = options.progressive;
+
+    switch (options.subsampling) {
+    case ImageEncoder::ChromaSubsampling::YUV444:
+        encoder_options.subsampling = JPEG_SUBSAMPLING_444;
+        break;
+    case ImageEncoder::ChromaSubsampling::YUV422:
+        encoder_options.subsampling = JPEG_SUBSAMPLING_422;
+        break;
+    case ImageEncoder::ChromaSubsampling::YUV420:
+        encoder_options.subsampling = JPEG_SUBSAMPLING_420;
+        break;
+    }
+
+    switch (options.dctMethod) {
+    case ImageEncoder::DCTMethod::ISLOW:
+        encoder_options.dct_method = JPEG_DCT_METHOD_ISLOW;
+        break;
+    case ImageEncoder::DCTMethod::IFAST:
+        encoder_options.dct_method = JPEG_DCT_METHOD_IFAST;
+        break;
+    case ImageEncoder::DCTMethod::FLOAT:
+        encoder_options.dct_method = JPEG_DCT_METHOD_FLOAT;
+        break;
+    }
+
+    encoder_options.alpha_mode = options.alphaMode == ImageEncoder::AlphaMode::Composite ? JPEG_ALPHA_COMPOSITE : JPEG_ALPHA_STRIP;
+    encoder_options.background[0] = options.background[0];
+    encoder_options.background[1] = options.background[1];
+    encoder_options.background[2] = options.background[2];
+
+    return encoder_options;
+}
+
+/**
+ * @brief Converts the public PNG options to the C encoder's representation.
+ */
+PNGEncoderOptions toEncoderOptions(const ImageEncoder::PNGOptions& options) {
+    PNGEncoderOptions encoder_options;
+    encoder_options.compression_level = options.compressionLevel;
+    encoder_options.buffer_size = options.bufferSize;
+
+    encoder_options.row_filters = 0;
+    if (options.rowFilters & ImageEncoder::RowFilter::None) {
+        encoder_options.row_filters |= PNG_ROW_FILTER_NONE;
+    }
+    if (options.rowFilters & ImageEncoder::RowFilter::Sub) {
+        encoder_options.row_filters |= PNG_ROW_FILTER_SUB;
+    }
+    if (options.rowFilters & ImageEncoder::RowFilter::Up) {
+        encoder_options.row_filters |= PNG_ROW_FILTER_UP;
+    }
+    if (options.rowFilters & ImageEncoder::RowFilter::Average) {
+        encoder_options.row_filters |= PNG_ROW_FILTER_AVERAGE;
+    }
+    if (options.rowFilters & ImageEncoder::RowFilter::Paeth) {
+        encoder_options.row_filters |= PNG_ROW_FILTER_PAETH;
+    }
+
+    switch (options.strategy) {
+    case ImageEncoder::CompressionStrategy::Default:
+        encoder_options.strategy = PNG_STRATEGY_DEFAULT;
+        break;
+    case ImageEncoder::CompressionStrategy::Filtered:
+        encoder_options.strategy = PNG_STRATEGY_FILTERED;
+        break;
+    case ImageEncoder::CompressionStrategy::HuffmanOnly:
+        encoder_options.strategy = PNG_STRATEGY_HUFFMAN_ONLY;
+        break;
+    case ImageEncoder::CompressionStrategy::RLE:
+        encoder_options.strategy = PNG_STRATEGY_RLE;
+        break;
+    case ImageEncoder::CompressionStrategy::Fixed:
+        encoder_options.strategy = PNG_STRATEGY_FIXED;
+        break;
+    }
+
+    return encoder_options;
+}
+
+} // namespace
+
+/**
+ * @brief Persistent PNG and JPEG compression state, created lazily on first use.
+ */
+struct ImageEncoder::Context {
+    PNGEncoder* png = nullptr;
+    JPEGEncoder* jpeg = nullptr;
+
+    Context() = default;
+    Context(const Context& other) = delete;
+    Context& operator=(const Context& other) = delete;
+
+    ~Context() {
+        destroyPNGEncoder(png);
+        destroyJPEGEncoder(jpeg);
+    }
+
+    PNGEncoder* getPNGEncoder() {
+        if (! png && ! (png = createPNGEncoder())) {
+            throw std::bad_alloc();
+        }
+        return png;
+    }
+
+    JPEGEncoder* getJPEGEncoder() {
+        if (! jpeg && ! (jpeg = createJPEGEncoder())) {
+            throw std::bad_alloc();
+        }
+        return jpeg;
+    }
+};
+
+/**
+ * @brief Takes an idle context from the encoder (or creates one) for the duration of an encode
+ * and hands it back afterwards.
+ */
+class ImageEncoder::ContextLease {
+    const ImageEncoder& m_encoder;
+    std::unique_ptr<Context> m_context;
+
+public:
+    explicit ContextLease(const ImageEncoder& encoder) : m_encoder(encoder) {
+        {
+            std::lock_guard<std::mutex> lock(m_encoder.m_contexts_mutex);
+            if (! m_encoder.m_contexts.empty()) {
+                m_context = std::move(m_encoder.m_contexts.back());
+                m_encoder.m_contexts.pop_back();
+            }
+        }
+        if (! m_context) {
+            m_context = std::make_unique<Context>();
+        }
+    }
+
+    ContextLease(const ContextLease& other) = delete;
+    ContextLease& operator=(const ContextLease& other) = delete;
+
+    ~ContextLease() {
+        try {
+            std::lock_guard<std::mutex> lock(m_encoder.m_contexts_mutex);
+            m_encoder.m_contexts.push_back(std::move(m_context));
+        } catch (...) {
+            // The context is simply dropped if it cannot be returned.
+        }
+    }
+
+    Context* operator->() const {
+        return m_context.get();
+    }
+};
+
 ImageEncoder::ImageEncoder(Type encoder_type) : m_type(encoder_type) {}
 
-void ImageEncoder::encodeImage(const uint8_t* rgb_buffer, int32_t width, int32_t height, int32_t number_of_channels, const std::string& filepath) const {
+ImageEncoder::~ImageEncoder() = default;
+
+void ImageEncoder::setJPEGOptions(const JPEGOptions& options) {
+    if (options.quality < 0 || options.quality > 100) {
+        throw std::invalid_argument("JPEG quality must be between 0 and 100");
+    }
+    m_jpeg_options = options;
+}
+
+const ImageEncoder::JPEGOptions& ImageEncoder::getJPEGOptions() const {
+    return m_jpeg_options;
+}
+
+void ImageEncoder::setPNGOptions(const PNGOptions& options) {
+    if (options.compressionLevel < -1 || options.compressionLevel > 9) {
+        throw std::invalid_argument("PNG compression level must be between -1 and 9");
+    }
+    if (options.rowFilters == 0 || (options.rowFilters & ~RowFilter::All) != 0) {
+        throw std::invalid_argument("PNG row filters must be a non-empty combination of RowFilter values");
+    }
+    if (options.bufferSize == 0 || options.bufferSize > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        throw std::invalid_argument("PNG buffer size is out of range");
+    }
+    m_png_options = options;
+}
+
+const ImageEncoder::PNGOptions& ImageEncoder::getPNGOptions() const {
+    return m_png_options;
+}
+
+void ImageEncoder::encodeImage(const uint8_t* rgb_buffer, int32_t width, int32_t height, int32_t number_of_channels, const std::string& filepath, size_t stride) const {
+    encodeImage(ImageView(rgb_buffer, width, height, number_of_channels, stride), filepath);
+}
+
+void ImageEncoder::encodeImage(const Image& image, const std::string& filepath) const {
+    encodeImage(ImageView(image), filepath);
+}
+
+void ImageEncoder::encodeImage(const ImageView& view, const std::string& filepath) const {
+    ContextLease context(*this);
+    JPEGEncoderOptions jpeg_options = toEncoderOptions(m_jpeg_options);
+    PNGEncoderOptions png_options = toEncoderOptions(m_png_options);
     switch (m_type)
     {
     case Type::PNG:
-        if (! encodeImageToPNG(rgb_buffer, width, height, number_of_channels, filepath.c_str())) {
+        if (! encodeImageToPNG(context->getPNGEncoder(), view.getBuffer(), view.getWidth(), view.getHeight(), view.getChannels(), pngBitDepth(view.getSampleType()), view.getStride(), &png_options, filepath.c_str())) {
             throw std::runtime_error(std::string("PNG: Failed to encode image at ") + filepath);
         }
         break;
     case Type::JPEG:
-        if (! encodeImageToJPEG(rgb_buffer, width, height, number_of_channels, filepath.c_str())) {
+        checkJPEGSampleType(view.getSampleType());
+        if (! encodeImageToJPEG(context->getJPEGEncoder(), view.getBuffer(), view.getWidth(), view.getHeight(), view.getChannels(), view.getStride(), &jpeg_options, filepath.c_str())) {
             throw std::runtime_error(std::string("JPEG: Failed to encode image at ") + filepath);
         }
         break;
     }
 }
 
-void ImageEncoder::encodeImage(const Image& image, const std::string& filepath) const {
-    encodeImage(image.getBuffer(), image.getWidth(), image.getHeight(), image.getChannels(), filepath);
+void ImageEncoder::encodeToBuffer(const uint8_t* rgb_buffer, int32_t width, int32_t height, int32_t number_of_channels, std::vector<uint8_t>& output, size_t stride) const {
+    encodeToBuffer(ImageView(rgb_buffer, width, height, number_of_channels, stride), output);
+}
+
+void ImageEncoder::encodeToBuffer(const Image& image, std::vector<uint8_t>& output) const {
+    encodeToBuffer(ImageView(image), output);
+}
+
+std::vector<uint8_t> ImageEncoder::encodeToBuffer(const Image& image) const {
+    std::vector<uint8_t> output;
+    encodeToBuffer(image, output);
+    return output;
+}
+
+void ImageEncoder::encodeToBuffer(const ImageView& view, std::vector<uint8_t>& output) const {
+    int bit_depth = 8;
+    if (m_type == Type::PNG) {
+        bit_depth = pngBitDepth(view.getSampleType());
+    } else {
+        checkJPEGSampleType(view.getSampleType());
+    }
+
+    ImageEncoderSink sink = makeVectorSink(output);
+
+    ContextLease context(*this);
+    JPEGEncoderOptions jpeg_options = toEncoderOptions(m_jpeg_options);
+    PNGEncoderOptions png_options = toEncoderOptions(m_png_options);
+    bool success = false;
+    switch (m_type)
+    {
+    case Type::PNG:
+        success = encodeImageToPNGSink(context->getPNGEncoder(), view.getBuffer(), view.getWidth(), view.getHeight(), view.getChannels(), bit_depth, view.getStride(), &png_options, &sink);
+        break;
+    case Type::JPEG:
+        success = encodeImageToJPEGSink(context->getJPEGEncoder(), view.getBuffer(), view.getWidth(), view.getHeight(), view.getChannels(), view.getStride(), &jpeg_options, &sink);
+        break;
+    }
+
+    if (! success) {
+        output.clear();
+        throw std::runtime_error(m_type == Type::PNG ? "PNG: Failed to encode image to memory" : "JPEG: Failed to encode image to memory");
+    }
+}
+
+std::vector<uint8_t> ImageEncoder::encodeToBuffer(const ImageView& view) const {
+    std::vector<uint8_t> output;
+    encodeToBuffer(view, output);
+    return output;
+}
+
+std::vector<ImageEncoder::BatchResult> ImageEncoder::encodeBatch(std::span<const Image* const> images, std::span<const std::string> filepaths, size_t concurrency, const ProgressCallback& progress) const {
+    if (images.size() != filepaths.size()) {
+        throw std::invalid_argument("Batch encode requires one file path per image");
+    }
+
+    auto encodeItem = [&](size_t index, BatchResult&) {
+        if (! images[index]) {
+            throw std::invalid_argument("Null image in batch");
+        }
+        encodeImage(*images[index], filepaths[index]);
+    };
+    return runBatch<BatchResult>(images.size(), concurrency, encodeItem, progress);
+}
+
+/**
+ * @brief State of a stream: the leased compression context and the output target.
+ */
+struct ImageEncoder::Stream::State {
+    const ImageEncoder& encoder;
+    ContextLease context;
+    Type type;
+    std::string filepath;
+    std::vector<uint8_t>* output;
+    ImageEncoderSink sink;
+    int32_t width;                  // Dimensions and layout of the image of the encode in progress.
+    int32_t channels;
+    Image::SampleType sample_type;
+    bool active;
+
+    State(const ImageEncoder& encoder, const std::string& filepath, std::vector<uint8_t>* output)
+        : encoder(encoder), context(encoder), type(encoder.m_type), filepath(filepath), output(output), sink(),
+          width(0), channels(0), sample_type(Image::SampleType::U8), active(false) {}
+
+    const char* name() const {
+        return type == Type::PNG ? "PNG" : "JPEG";
+    }
+
+    [[noreturn]] void fail(const char* operation) {
+        active = false;
+        if (output) {
+            output->clear();
+        }
+        throw std::runtime_error(std::string(name()) + ": Failed to " + operation + (output ? " to memory" : " at " + filepath));
+    }
+
+    void abort() {
+        if (! active) {
+            return;
+        }
+        active = false;
+        if (type == Type::PNG) {
+            abortPNGEncode(context->getPNGEncoder());
+        } else {
+            abortJPEGEncode(context->getJPEGEncoder());
+        }
+    }
+};
+
+ImageEncoder::Stream::Stream(const ImageEncoder& encoder, const std::string& filepath)
+    : m_state(std::make_unique<State>(encoder, filepath, nullptr)) {}
+
+ImageEncoder::Stream::Stream(const ImageEncoder& encoder, std::vector<uint8_t>& output)
+    : m_state(std::make_unique<State>(encoder, std::string(), &output)) {}
+
+ImageEncoder::Stream::~Stream() {
+    m_state->abort();
+}
+
+void ImageEncoder::Stream::begin(int32_t width, int32_t height, int32_t number_of_channels, Image::SampleType sample_type) {
+    m_state->abort();
+    m_state->type = m_state->encoder.m_type;
+
+    int bit_depth = 8;
+    if (m_state->type == Type::PNG) {
+        bit_depth = pngBitDepth(sample_type);
+    } else {
+        checkJPEGSampleType(sample_type);
+    }
+
+    if (m_state->output) {
+        m_state->sink = makeVectorSink(*m_state->output);
+    }
+
+    bool success = false;
+    if (m_state->type == Type::PNG) {
+        PNGEncoderOptions options = toEncoderOptions(m_state->encoder.m_png_options);
+        PNGEncoder* encoder = m_state->context->getPNGEncoder();
+        success = m_state->output
+            ? beginPNGEncodeToSink(encoder, width, height, number_of_channels, bit_depth, &options, &m_state->sink)
+            : beginPNGEncode(encoder, width, height, number_of_channels, bit_depth, &options, m_state->filepath.c_str());
+    } else {
+        JPEGEncoderOptions options = toEncoderOptions(m_state->encoder.m_jpeg_options);
+        JPEGEncoder* encoder = m_state->context->getJPEGEncoder();
+        success = m_state->output
+            ? beginJPEGEncodeToSink(encoder, width, height, number_of_channels, &options, &m_state->sink)
+            : beginJPEGEncode(encoder, width, height, number_of_channels, &options, m_state->filepath.c_str());
+    }
+
+    if (! success) {
+        m_state->fail("start encoding image");
+    }
+    m_state->width = width;
+    m_state->channels = number_of_channels;
+    m_state->sample_type = sample_type;
+    m_state->active = true;
+}
+
+void ImageEncoder::Stream::writeRows(const uint8_t* rows, int32_t count, size_t stride) {
+    if (! m_state->active) {
+        throw std::logic_error("Image stream has no encode in progress");
+    }
+    stride = Image::packedStride(m_state->width, m_state->channels, m_state->sample_type, stride);
+
+    bool success = m_state->type == Type::PNG
+        ? writePNGRows(m_state->context->getPNGEncoder(), rows, count, stride)
+        : writeJPEGRows(m_state->context->getJPEGEncoder(), rows, count, stride);
+    if (! success) {
+        m_state->fail("encode rows of image");
+    }
+}
+
+void ImageEncoder::Stream::finish() {
+    if (! m_state->active) {
+        throw std::logic_error("Image stream has no encode in progress");
+    }
+
+    bool success = m_state->type == Type::PNG
+        ? finishPNGEncode(m_state->context->getPNGEncoder())
+        : finishJPEGEncode(m_state->context->getJPEGEncoder());
+    if (! success) {
+        m_state->fail("finish encoding image");
+    }
+
+    m_state->active = false;
 }
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+
+/**
+ * Error manager that returns control to the encoder or decoder instead of terminating the process,
+ * and keeps the message of the error. Every libjpeg call that can fail must be preceded by a setjmp
+ * on jump_buffer.
+ */
+struct JPEGErrorManager {
+    struct jpeg_error_mgr base;
+    jmp_buf jump_buffer;
+    char message[JMSG_LENGTH_MAX];
+};
+
+static inline void exitJPEGOnError(j_common_ptr cinfo) {
+    struct JPEGErrorManager* error_manager = (struct JPEGErrorManager*)cinfo->err;
+    (*cinfo->err->format_message)(cinfo, error_manager->message);
+    longjmp(error_manager->jump_buffer, 1);
+}
+
+/**
+ * Sets up the error manager with libjpeg's defaults and an empty message, but with errors returning
+ * to the last setjmp on its jump buffer. Returns the manager to install as the err field.
+ */
+static inline struct jpeg_error_mgr* initJPEGErrorManager(struct JPEGErrorManager* error_manager) {
+    struct jpeg_error_mgr* base = jpeg_std_error(&error_manager->base);
+    base->error_exit = exitJPEGOnError;
+    error_manager->message[0] = '\0';
+    return base;
+}
+
+/**
+ * Divides a product of two 8-bit values by 255, rounding to nearest.
+ */
+static inline uint8_t divideBy255(unsigned value) {
+    value += 128;
+    return (uint8_t)((value + (value >> 8)) >> 8);
+}
@@ -0,0 +1,212 @@
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "image-pool.h"
+
+namespace {
+
+/**
+ * @brief Header placed in front of every buffer, so its size is known when it returns to the pool.
+ * Padded to the allocator alignment to keep the pixels equally aligned.
+ */
+struct BufferHeader {
+    size_t size;    // Size of the buffer in bytes, excluding the header.
+};
+
+constexpr size_t HEADER_SIZE = ImageAllocator::ALIGNMENT;
+static_assert(sizeof(BufferHeader) <= HEADER_SIZE);
+
+uint8_t* pixels(BufferHeader* header) {
+    return reinterpret_cast<uint8_t*>(header) + HEADER_SIZE;
+}
+
+BufferHeader* header(void* pixels) {
+    return reinterpret_cast<BufferHeader*>(static_cast<uint8_t*>(pixels) - HEADER_SIZE);
+}
+
+/**
+ * @brief Computes the buffer size for an image shape. Rejects strides that Image would reject, before
+ * a buffer is taken for them.
+ */
+size_t bufferSize(int32_t width, int32_t height, int32_t channels, size_t stride) {
+    stride = Image::packedStride(width, channels, Image::SampleType::U8, stride);
+    return height > 0 ? stride * height : 0;
+}
+
+} // namespace
+
+/**
+ * @brief State shared by the pool and its outstanding images.
+ */
+struct ImagePool::State {
+    /**
+     * @brief Idle buffers of one size.
+     */
+    struct Bucket {
+        size_t size;
+        std::vector<BufferHeader*> buffers;
+    };
+
+    ImageAllocator* allocator;              // Allocator the buffers come from.
+    size_t max_idle_buffers;                // Maximum number of idle buffers per size.
+    std::atomic<size_t> references;         // The pool itself plus one per outstanding image.
+    std::vector<Bucket> buckets;            // Idle buffers by size; a workload uses only a few sizes.
+    bool closed = false;                    // Whether the pool has been destroyed, so returned buffers are deallocated.
+    mutable std::mutex mutex;               // Guards the buckets and the closed flag.
+
+    ~State() {
+        trim();
+    }
+
+    /**
+     * @brief Finds the bucket for a size, creating it with room for the maximum number of idle
+     * buffers so that returning buffers never allocates. Requires the mutex to be held.
+     */
+    Bucket& bucket(size_t size) {
+        for (Bucket& bucket : buckets) {
+            if (bucket.size == size) {
+                return bucket;
+            }
+        }
+        buckets.push_back(Bucket{size, {}});
+        buckets.back().buffers.reserve(max_idle_buffers);
+        return buckets.back();
+    }
+
+    /**
+     * @brief Takes an idle buffer of the specified size, or allocates a new one.
+     */
+    BufferHeader* take(size_t size) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Bucket& idle = bucket(size);
+            if (! idle.buffers.empty()) {
+                BufferHeader* buffer = idle.buffers.back();
+                idle.buffers.pop_back();
+                return buffer;
+            }
+        }
+
+        auto* buffer = static_cast<BufferHeader*>(allocator->allocate(HEADER_SIZE + size));
+        if (! buffer) {
+            throw std::bad_alloc();
+        }
+        buffer->size = size;
+        return buffer;
+    }
+
+    /**
+     * @brief Keeps a buffer for reuse, or deallocates it if the pool is closed or has no bucket with
+     * room for it. Runs when images are destroyed, so it never allocates: buckets are only created
+     * by take() and reserve(), with their room reserved up front.
+     */
+    void put(BufferHeader* buffer) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (! closed) {
+                for (Bucket& idle : buckets) {
+                    if (idle.size == buffer->size) {
+                        if (idle.buffers.size() < max_idle_buffers) {
+                            idle.buffers.push_back(buffer);
+                            return;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+        allocator->deallocate(buffer, HEADER_SIZE + buffer->size);
+    }
+
+    /**
+     * @brief Deallocates all idle buffers.
+     */
+    void trim() {
+        std::vector<Bucket> released;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            released.swap(buckets);
+        }
+        for (Bucket& idle : released) {
+            for (BufferHeader* buffer : idle.buffers) {
+                allocator->deallocate(buffer, HEADER_SIZE + buffer->size);
+            }
+        }
+    }
+
+    /**
+     * @brief Drops a reference, destroying the state when it was the last one.
+     */
+    void unreference() {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    /**
+     * @brief Deallocator of the pool's images: returns the buffer and drops the image's reference.
+     */
+    static void recycle(void* buffer, void* context) {
+        auto* state = static_cast<State*>(context);
+        state->put(header(buffer));
+        state->unreference();
+    }
+};
+
+ImagePool::ImagePool(size_t max_idle_buffers, ImageAllocator* allocator) : m_state(new State) {
+    m_state->allocator = allocator ? allocator : &ImageAllocator::getDefault();
+    m_state->max_idle_buffers = max_idle_buffers;
+    m_state->references.store(1, std::memory_order_relaxed);
+}
+
+ImagePool::~ImagePool() {
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->closed = true;
+    }
+    m_state->trim();
+    m_state->unreference();
+}
+
+Image ImagePool::acquire(int32_t width, int32_t height, int32_t channels, size_t stride) {
+    BufferHeader* buffer = m_state->take(bufferSize(width, height, channels, stride));
+    m_state->references.fetch_add(1, std::memory_order_relaxed);
+    return Image(pixels(buffer), width, height, channels, stride, &State::recycle, m_state);
+}
+
+void ImagePool::reserve(int32_t width, int32_t height, int32_t channels, size_t count, size_t stride) {
+    size_t size = bufferSize(width, height, channels, stride);
+    size_t idle;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        idle = m_state->bucket(size).buffers.size();
+    }
+
+    for (; idle < count && idle < m_state->max_idle_buffers; idle++) {
+        auto* buffer = static_cast<BufferHeader*>(m_state->allocator->allocate(HEADER_SIZE + size));
+        if (! buffer) {
+            throw std::bad_alloc();
+        }
+        buffer->size = size;
+
+        // Fault the pages in now rather than on first use.
+        std::memset(pixels(buffer), 0, size);
+        m_state->put(buffer);
+    }
+}
+
+void ImagePool::trim() {
+    m_state->trim();
+}
+
+size_t ImagePool::getIdleCount() const {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    size_t count = 0;
+    for (const State::Bucket& idle : m_state->buckets) {
+        count += idle.buffers.size();
+    }
+    return count;
+}
@@ -0,0 +1,651 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <latch>
+#include <mutex>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cpu-features.h"
+#include "image-resizer.h"
+#include "thread-pool.h"
+
+namespace {
+
+/**
+ * @brief Fixed-point precision of the filter coefficients. The coefficients of every target pixel
+ * sum to exactly 1 << COEFFICIENT_BITS, so flat areas keep their values.
+ */
+constexpr int COEFFICIENT_BITS = 14;
+
+/**
+ * @brief Fractional bits kept in the intermediate samples between the horizontal and vertical
+ * passes. Six bits leave room for the overshoot of sharpening filters within 16 bits.
+ */
+constexpr int INTERMEDIATE_BITS = 6;
+
+constexpr int HORIZONTAL_SHIFT = COEFFICIENT_BITS - INTERMEDIATE_BITS;
+constexpr int VERTICAL_SHIFT = COEFFICIENT_BITS + INTERMEDIATE_BITS;
+
+/**
+ * @brief Target size of the intermediate samples of a strip, about a typical per-core L2 cache.
+ */
+constexpr size_t STRIP_BUDGET = 256 * 1024;
+
+/**
+ * @brief Filter coefficients of one axis. Every target sample reads `taps` consecutive source
+ * samples starting at its own start, padded with zero coefficients where the filter is narrower.
+ */
+struct Coefficients {
+    int32_t taps = 0;                   // Coefficients per target sample.
+    int32_t vector_count = 0;           // Number of leading target samples whose window SIMD kernels may read.
+    std::vector<int32_t> starts;        // First source sample of the window of each target sample.
+    std::vector<int16_t> weights;       // `taps` coefficients per target sample.
+};
+
+double boxFilter(double x) {
+    return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+}
+
+double triangleFilter(double x) {
+    x = std::fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+double cubicFilter(double x) {
+    constexpr double a = -0.5;
+    x = std::fabs(x);
+    if (x < 1.0) {
+        return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+    }
+    if (x < 2.0) {
+        return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+    }
+    return 0.0;
+}
+
+double sinc(double x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= std::numbers::pi;
+    return std::sin(x) / x;
+}
+
+double lanczos3Filter(double x) {
+    return x > -3.0 && x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+/**
+ * @brief Computes the filter coefficients for scaling an axis of `source_size` samples to `target_size`.
+ * 
+ * @param alignment The number of taps is rounded up to a multiple of this, for the SIMD kernels.
+ * @param slack Number of samples past the end of a window that SIMD kernels may read.
+ */
+Coefficients computeCoefficients(int32_t source_size, int32_t target_size, ImageResizer::Filter filter, int32_t alignment, int32_t slack) {
+    double (*kernel)(double) = lanczos3Filter;
+    double radius = 3.0;
+    switch (filter) {
+        case ImageResizer::Filter::Box:
+            kernel = boxFilter;
+            radius = 0.5;
+            break;
+        case ImageResizer::Filter::Bilinear:
+            kernel = triangleFilter;
+            radius = 1.0;
+            break;
+        case ImageResizer::Filter::Bicubic:
+            kernel = cubicFilter;
+            radius = 2.0;
+            break;
+        case ImageResizer::Filter::Lanczos3:
+            break;
+    }
+
+    // Widen the filter when downscaling, so it covers every source sample.
+    const double scale = static_cast<double>(source_size) / target_size;
+    const double filter_scale = std::max(scale, 1.0);
+    const double support = radius * filter_scale;
+
+    // The windows of the target samples, with exact weights.
+    std::vector<int32_t> first(target_size);
+    std::vector<int32_t> count(target_size);
+    int32_t max_count = 1;
+    for (int32_t i = 0; i < target_size; i++) {
+        double center = (i + 0.5) * scale;
+        first[i] = std::clamp(static_cast<int32_t>(std::floor(center - support + 0.5)), 0, source_size - 1);
+        count[i] = std::clamp(static_cast<int32_t>(std::floor(center + support + 0.5)), first[i] + 1, source_size) - first[i];
+        max_count = std::max(max_count, count[i]);
+    }
+
+    Coefficients coefficients;
+    coefficients.taps = (max_count + alignment - 1) / alignment * alignment;
+    if (coefficients.taps + slack > source_size) {
+        // The source is too small for padded windows; the scalar kernels don't need them.
+        coefficients.taps = max_count;
+        slack = source_size;
+    }
+    coefficients.starts.resize(target_size);
+    coefficients.weights.assign(static_cast<size_t>(target_size) * coefficients.taps, 0);
+
+    std::vector<double> weights(max_count);
+    for (int32_t i = 0; i < target_size; i++) {
+        double center = (i + 0.5) * scale;
+        double total = 0.0;
+        for (int32_t k = 0; k < count[i]; k++) {
+            weights[k] = kernel((first[i] + k - center + 0.5) / filter_scale);
+            total += weights[k];
+        }
+
+        // Quantize the normalized weights and put the rounding error on the largest one.
+        int16_t* quantized = coefficients.weights.data() + static_cast<size_t>(i) * coefficients.taps;
+        int32_t start = std::min(first[i], source_size - coefficients.taps);
+        int32_t offset = first[i] - start;
+        int32_t sum = 0;
+        int32_t largest = offset;
+        for (int32_t k = 0; k < count[i]; k++) {
+            double weight = total != 0.0 ? weights[k] / total : (k == 0 ? 1.0 : 0.0);
+            quantized[offset + k] = static_cast<int16_t>(std::lround(weight * (1 << COEFFICIENT_BITS)));
+            sum += quantized[offset + k];
+            if (std::abs(quantized[offset + k]) > std::abs(quantized[largest])) {
+                largest = offset + k;
+            }
+        }
+        quantized[largest] = static_cast<int16_t>(quantized[largest] + (1 << COEFFICIENT_BITS) - sum);
+
+        coefficients.starts[i] = start;
+        if (start + coefficients.taps + slack <= source_size) {
+            coefficients.vector_count = i + 1;
+        }
+    }
+
+    return coefficients;
+}
+
+/**
+ * @brief Filters a row horizontally into intermediate samples.
+ */
+using HorizontalKernel = void (*)(const uint8_t* source, int16_t* destination, const Coefficients& coefficients, int32_t width);
+
+/**
+ * @brief Filters `taps` intermediate rows vertically into a row of `count` 8-bit samples.
+ */
+using VerticalKernel = void (*)(const int16_t* const* rows, const int16_t* weights, int32_t taps, uint8_t* destination, int32_t count);
+
+/**
+ * @brief Rounds and scales a horizontal sum to an intermediate sample.
+ */
+int16_t toIntermediate(int32_t sum) {
+    sum = (sum + (1 << (HORIZONTAL_SHIFT - 1))) >> HORIZONTAL_SHIFT;
+    return static_cast<int16_t>(std::clamp(sum, -32768, 32767));
+}
+
+/**
+ * @brief Rounds, scales and clamps a vertical sum to an 8-bit sample.
+ */
+uint8_t toSample(int32_t sum) {
+    sum = (sum + (1 << (VERTICAL_SHIFT - 1))) >> VERTICAL_SHIFT;
+    return static_cast<uint8_t>(std::clamp(sum, 0, 255));
+}
+
+// Scalar kernels. The SIMD kernels compute the same integer sums, so all produce identical results.
+
+/**
+ * @brief Filters the target samples from `begin` to `end` of a row horizontally.
+ */
+template <int Channels>
+void filterHorizontally(const uint8_t* source, int16_t* destination, const Coefficients& coefficients, int32_t begin, int32_t end) {
+    for (int32_t x = begin; x < end; x++) {
+        const uint8_t* pixels = source + static_cast<size_t>(coefficients.starts[x]) * Channels;
+        const int16_t* weights = coefficients.weights.data() + static_cast<size_t>(x) * coefficients.taps;
+        int32_t sums[Channels] = {};
+        for (int32_t k = 0; k < coefficients.taps; k++) {
+            for (int c = 0; c < Channels; c++) {
+                sums[c] += pixels[k * Channels + c] * weights[k];
+            }
+        }
+        for (int c = 0; c < Channels; c++) {
+            destination[x * Channels + c] = toIntermediate(sums[c]);
+        }
+    }
+}
+
+template <int Channels>
+void horizontalScalar(const uint8_t* source, int16_t* destination, const Coefficients& coefficients, int32_t width) {
+    filterHorizontally<Channels>(source, destination, coefficients, 0, width);
+}
+
+/**
+ * @brief Filters the samples from `begin` to `end` of a row vertically.
+ */
+void filterVertically(const int16_t* const* rows, const int16_t* weights, int32_t taps, uint8_t* destination, int32_t begin, int32_t end) {
+    for (int32_t i = begin; i < end; i++) {
+        int32_t sum = 0;
+        for (int32_t k = 0; k < taps; k++) {
+            sum += rows[k][i] * weights[k];
+        }
+        destination[i] = toSample(sum);
+    }
+}
+
+void verticalScalar(const int16_t* const* rows, const int16_t* weights, int32_t taps, uint8_t* destination, int32_t count) {
+    filterVertically(rows, weights, taps, destination, 0, count);
+}
+
+#if IMAGE_HAS_X86_SIMD
+
+// SIMD kernels. The horizontal kernels gather the samples of a group of taps into 16-bit lanes,
+// ordered so that pmaddwd multiplies and adds pairs of taps of the same channel. The groups span
+// 8 bytes of source pixels: 2 taps for 3 and 4 channels, 4 taps for 2 channels, 8 taps for gray.
+
+/**
+ * @brief Number of taps in a group of 8 bytes of source pixels.
+ */
+constexpr int32_t groupTaps(int channels) {
+    return channels == 1 ? 8 : channels == 2 ? 4 : 2;
+}
+
+/**
+ * @brief Shuffle gathering a group of pixels into 16-bit lanes of tap pairs.
+ */
+template <int Channels>
+__attribute__((target("ssse3"))) __m128i gatherShuffle() {
+    if constexpr (Channels == 4) {
+        return _mm_setr_epi8(0, -1, 4, -1, 1, -1, 5, -1, 2, -1, 6, -1, 3, -1, 7, -1);
+    } else if constexpr (Channels == 3) {
+        return _mm_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1);
+    } else if constexpr (Channels == 2) {
+        return _mm_setr_epi8(0, -1, 2, -1, 1, -1, 3, -1, 4, -1, 6, -1, 5, -1, 7, -1);
+    } else {
+        return _mm_setr_epi8(0, -1, 1, -1, 2, -1, 3, -1, 4, -1, 5, -1, 6, -1, 7, -1);
+    }
+}
+
+/**
+ * @brief Spreads the weights of a group to the lanes of its pixels.
+ */
+template <int Channels>
+__attribute__((target("ssse3"))) __m128i spreadWeights(const int16_t* weights) {
+    if constexpr (Channels >= 3) {
+        int32_t pair;
+        std::memcpy(&pair, weights, sizeof(pair));
+        return _mm_set1_epi32(pair);
+    } else if constexpr (Channels == 2) {
+        return _mm_shuffle_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights)), _MM_SHUFFLE(1, 1, 0, 0));
+    } else {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(weights));
+    }
+}
+
+/**
+ * @brief Reduces the per-lane sums of a target pixel to one sum per channel, scales them to
+ * intermediate samples and stores them.
+ */
+template <int Channels>
+__attribute__((target("ssse3"))) void storeIntermediate(__m128i sums, int16_t* destination) {
+    if constexpr (Channels == 2) {
+        sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 8));
+    } else if constexpr (Channels == 1) {
+        sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 8));
+        sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 4));
+    }
+    sums = _mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(1 << (HORIZONTAL_SHIFT - 1))), HORIZONTAL_SHIFT);
+    __m128i samples = _mm_packs_epi32(sums, sums);
+    if constexpr (Channels == 4) {
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination), samples);
+    } else if constexpr (Channels == 3) {
+        int32_t pair = _mm_cvtsi128_si32(samples);
+        std::memcpy(destination, &pair, sizeof(pair));
+        destination[2] = static_cast<int16_t>(_mm_extract_epi16(samples, 2));
+    } else if constexpr (Channels == 2) {
+        int32_t pair = _mm_cvtsi128_si32(samples);
+        std::memcpy(destination, &pair, sizeof(pair));
+    } else {
+        destination[0] = static_cast<int16_t>(_mm_extract_epi16(samples, 0));
+    }
+}
+
+template <int Channels>
+__attribute__((target("ssse3"))) void horizontalSSSE3(const uint8_t* source, int16_t* destination, const Coefficients& coefficients, int32_t width) {
+    constexpr int32_t group = groupTaps(Channels);
+    const __m128i shuffle = gatherShuffle<Channels>();
+    for (int32_t x = 0; x < coefficients.vector_count; x++) {
+        const uint8_t* pixels = source + static_cast<size_t>(coefficients.starts[x]) * Channels;
+        const int16_t* weights = coefficients.weights.data() + static_cast<size_t>(x) * coefficients.taps;
+        __m128i sums = _mm_setzero_si128();
+        for (int32_t k = 0; k < coefficients.taps; k += group) {
+            __m128i samples = _mm_shuffle_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels + k * Channels)), shuffle);
+            sums = _mm_add_epi32(sums, _mm_madd_epi16(samples, spreadWeights<Channels>(weights + k)));
+        }
+        storeIntermediate<Channels>(sums, destination + x * Channels);
+    }
+    filterHorizontally<Channels>(source, destination, coefficients, coefficients.vector_count, width);
+}
+
+/**
+ * @brief Filters the samples from `begin` to `count` of a row vertically, 16 at a time.
+ */
+__attribute__((target("ssse3"))) void filterVerticallySSSE3(const int16_t* const* rows, const int16_t* weights, int32_t taps, uint8_t* destination, int32_t begin, int32_t count) {
+    const __m128i rounding = _mm_set1_epi32(1 << (VERTICAL_SHIFT - 1));
+    int32_t i = begin;
+    for (; i + 16 <= count; i += 16) {
+        __m128i sums[4] = {rounding, rounding, rounding, rounding};
+        for (int32_t k = 0; k < taps; k += 2) {
+            // Pair the taps up; an odd last tap is paired with itself at zero weight.
+            const int16_t* a = rows[k] + i;
+            const int16_t* b = k + 1 < taps ? rows[k + 1] + i : a;
+            int16_t weight_b = k + 1 < taps ? weights[k + 1] : 0;
+            __m128i pair = _mm_set1_epi32(static_cast<int32_t>(static_cast<uint16_t>(weights[k]) | (static_cast<uint32_t>(static_cast<uint16_t>(weight_b)) << 16)));
+            for (int half = 0; half < 2; half++) {
+                __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + half * 8));
+                __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + half * 8));
+                sums[half * 2] = _mm_add_epi32(sums[half * 2], _mm_madd_epi16(_mm_unpacklo_epi16(first, second), pair));
+                sums[half * 2 + 1] = _mm_add_epi32(sums[half * 2 + 1], _mm_madd_epi16(_mm_unpackhi_epi16(first, second), pair));
+            }
+        }
+        __m128i low = _mm_packs_epi32(_mm_srai_epi32(sums[0], VERTICAL_SHIFT), _mm_srai_epi32(sums[1], VERTICAL_SHIFT));
+        __m128i high = _mm_packs_epi32(_mm_srai_epi32(sums[2], VERTICAL_SHIFT), _mm_srai_epi32(sums[3], VERTICAL_SHIFT));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(low, high));
+    }
+    filterVertically(rows, weights, taps, destination, i, count);
+}
+
+__attribute__((target("ssse3"))) void verticalSSSE3(const int16_t* const* rows, const int16_t* weights, int32_t taps, uint8_t* destination, int32_t count) {
+    filterVerticallySSSE3(rows, weights, taps, destination, 0, count);
+}
+
+/**
+ * @brief Shuffle gathering two groups of pixels, one per 128-bit lane, from 16 loaded bytes.
+ */
+template <int Channels>
+__attribute__((target("avx2"))) __m256i gatherShuffleAVX2() {
+    // The second group starts right after the first: 6 bytes in for RGB, 8 bytes otherwise.
+    const __m128i first = gatherShuffle<Channels>();
+    const __m128i offset = _mm_set1_epi8(Channels == 3 ? 6 : 8);
+    const __m128i second = _mm_blendv_epi8(_mm_add_epi8(first, offset), first, first);
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(first), second, 1);
+}
+
+template <int Channels>
+__attribute__((target("avx2"))) void horizontalAVX2(const uint8_t* source, int16_t* destination, const Coefficients& coefficients, int32_t width) {
+    constexpr int32_t group = groupTaps(Channels);
+    const __m256i shuffle = gatherShuffleAVX2<Channels>();
+    for (int32_t x = 0; x < coefficients.vector_count; x++) {
+        const uint8_t* pixels = source + static_cast<size_t>(coefficients.starts[x]) * Channels;
+        const int16_t* weights = coefficients.weights.data() + static_cast<size_t>(x) * coefficients.taps;
+        __m256i sums = _mm256_setzero_si256();
+        for (int32_t k = 0; k < coefficients.taps; k += 2 * group) {
+            __m256i samples;
+            __m256i spread;
+            if constexpr (Channels == 1) {
+                samples = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + k)));
+                spread = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(weights + k));
+            } else {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + k * Channels));
+                samples = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(bytes), shuffle);
+                if constexpr (Channels == 2) {
+                    __m256i loaded = _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(weights + k)));
+                    spread = _mm256_permutevar8x32_epi32(loaded, _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+                } else {
+                    __m256i loaded = _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + k)));
+                    spread = _mm256_permutevar8x32_epi32(loaded, _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1));
+                }
+            }
+            sums = _mm256_add_epi32(sums, _mm256_madd_epi16(samples, spread));
+        }
+        __m128i lanes = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        storeIntermediate<Channels>(lanes, destination + x * Channels);
+    }
+    filterHorizontally<Channels>(source, destination, coefficients, coefficients.vector_count, width);
+}
+
+__attribute__((target("avx2"))) void verticalAVX2(const int16_t* const* rows, const int16_t* weights, int32_t taps, uint8_t* destination, int32_t count) {
+    const __m256i rounding = _mm256_set1_epi32(1 << (VERTICAL_SHIFT - 1));
+    int32_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i sums[4] = {rounding, rounding, rounding, rounding};
+        for (int32_t k = 0; k < taps; k += 2) {
+            // Pair the taps up; an odd last tap is paired with itself at zero weight.
+            const int16_t* a = rows[k] + i;
+            const int16_t* b = k + 1 < taps ? rows[k + 1] + i : a;
+            int16_t weight_b = k + 1 < taps ? weights[k + 1] : 0;
+            __m256i pair = _mm256_set1_epi32(static_cast<int32_t>(static_cast<uint16_t>(weights[k]) | (static_cast<uint32_t>(static_cast<uint16_t>(weight_b)) << 16)));
+            for (int half = 0; half < 2; half++) {
+                __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + half * 16));
+                __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + half * 16));
+                sums[half * 2] = _mm256_add_epi32(sums[half * 2], _mm256_madd_epi16(_mm256_unpacklo_epi16(first, second), pair));
+                sums[half * 2 + 1] = _mm256_add_epi32(sums[half * 2 + 1], _mm256_madd_epi16(_mm256_unpackhi_epi16(first, second), pair));
+            }
+        }
+        // Unpacking and packing both work per lane, so the samples stay in order within each lane
+        // and only the final 64-bit quarters need reordering.
+        __m256i low = _mm256_packs_epi32(_mm256_srai_epi32(sums[0], VERTICAL_SHIFT), _mm256_srai_epi32(sums[1], VERTICAL_SHIFT));
+        __m256i high = _mm256_packs_epi32(_mm256_srai_epi32(sums[2], VERTICAL_SHIFT), _mm256_srai_epi32(sums[3], VERTICAL_SHIFT));
+        __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), bytes);
+    }
+    filterVerticallySSSE3(rows, weights, taps, destination, i, count);
+}
+
+#endif
+
+/**
+ * @brief The resampling kernels of one instruction set tier.
+ */
+struct Kernels {
+    HorizontalKernel horizontal[4];     // Indexed by the channel count minus one.
+    VerticalKernel vertical;
+};
+
+/**
+ * @brief Retrieves the kernels of an instruction set tier, which the CPU must support.
+ */
+Kernels selectKernels(CpuTier tier) {
+    switch (tier) {
+#if IMAGE_HAS_X86_SIMD
+        case CpuTier::AVX2:
+            return {{horizontalAVX2<1>, horizontalAVX2<2>, horizontalAVX2<3>, horizontalAVX2<4>}, verticalAVX2};
+        case CpuTier::SSSE3:
+            return {{horizontalSSSE3<1>, horizontalSSSE3<2>, horizontalSSSE3<3>, horizontalSSSE3<4>}, verticalSSSE3};
+#endif
+        default:
+            return {{horizontalScalar<1>, horizontalScalar<2>, horizontalScalar<3>, horizontalScalar<4>}, verticalScalar};
+    }
+}
+
+/**
+ * @brief Retrieves the kernels of the widest instruction set the CPU supports, selected on first use.
+ */
+const Kernels& getKernels() {
+    static const Kernels kernels = selectKernels(getCpuTier());
+    return kernels;
+}
+
+/**
+ * @brief Number of taps the horizontal SIMD kernels consume per step, which the number of
+ * horizontal taps is padded to.
+ */
+int32_t horizontalAlignment(int32_t channels) {
+    switch (channels) {
+        case 1:
+            return 16;
+        case 2:
+            return 8;
+        default:
+            return 4;
+    }
+}
+
+/**
+ * @brief Intermediate rows held by a thread between the strips it resizes.
+ */
+struct StripRows {
+    std::vector<int16_t> samples;       // Horizontally filtered rows, one after another.
+    std::vector<const int16_t*> taps;   // Rows read for the current target row.
+    int32_t first = 0;                  // Source row of the first intermediate row.
+    int32_t count = 0;                  // Number of intermediate rows; zero when nothing is held.
+};
+
+/**
+ * @brief Resizes the target rows from `begin` to `end`, filtering the source rows they need
+ * horizontally into `strip` first. Rows already held from the previous strip are reused rather than
+ * filtered again.
+ */
+void resizeStrip(const ImageView& source, uint8_t* destination, size_t stride, const Coefficients& horizontal, const Coefficients& vertical,
+                 int32_t width, int32_t begin, int32_t end, StripRows& strip) {
+    const Kernels& kernels = getKernels();
+    const int32_t channels = source.getChannels();
+    const size_t row_size = static_cast<size_t>(width) * channels;
+
+    const int32_t first_row = vertical.starts[begin];
+    const int32_t row_count = vertical.starts[end - 1] + vertical.taps - first_row;
+    if (strip.samples.size() < row_size * row_count) {
+        strip.samples.resize(row_size * row_count);
+    }
+    int32_t kept = 0;
+    if (strip.count > 0 && first_row >= strip.first && first_row < strip.first + strip.count) {
+        kept = std::min(strip.first + strip.count - first_row, row_count);
+        std::memmove(strip.samples.data(), strip.samples.data() + (first_row - strip.first) * row_size, kept * row_size * sizeof(int16_t));
+    }
+    for (int32_t y = kept; y < row_count; y++) {
+        kernels.horizontal[channels - 1](source.getRow(first_row + y), strip.samples.data() + y * row_size, horizontal, width);
+    }
+    strip.first = first_row;
+    strip.count = row_count;
+
+    strip.taps.resize(vertical.taps);
+    for (int32_t y = begin; y < end; y++) {
+        for (int32_t k = 0; k < vertical.taps; k++) {
+            strip.taps[k] = strip.samples.data() + (vertical.starts[y] - first_row + k) * row_size;
+        }
+        const int16_t* weights = vertical.weights.data() + static_cast<size_t>(y) * vertical.taps;
+        kernels.vertical(strip.taps.data(), weights, vertical.taps, destination + y * stride, static_cast<int32_t>(row_size));
+    }
+}
+
+/**
+ * @brief Resizes the strips from `first` to `last` one after another, so that neighbouring strips
+ * share their intermediate rows.
+ */
+void resizeStrips(const ImageView& source, uint8_t* destination, size_t stride, const Coefficients& horizontal, const Coefficients& vertical,
+                  int32_t width, int32_t height, int32_t strip_height, int32_t first, int32_t last) {
+    thread_local StripRows strip;
+    strip.count = 0;
+    for (int32_t index = first; index < last; index++) {
+        const int32_t begin = index * strip_height;
+        resizeStrip(source, destination, stride, horizontal, vertical, width, begin, std::min(begin + strip_height, height), strip);
+    }
+}
+
+} // namespace
+
+ImageResizer::ImageResizer(Filter filter) : m_filter(filter) {}
+
+ImageResizer::~ImageResizer() = default;
+
+void ImageResizer::setFilter(Filter filter) {
+    m_filter = filter;
+}
+
+ImageResizer::Filter ImageResizer::getFilter() const {
+    return m_filter;
+}
+
+void ImageResizer::setConcurrency(size_t concurrency) {
+    if (concurrency == 0) {
+        concurrency = ThreadPool::defaultThreadCount();
+    }
+    if (concurrency == m_concurrency) {
+        return;
+    }
+    m_pool.reset();
+    if (concurrency > 1) {
+        m_pool = std::make_unique<ThreadPool>(concurrency);
+    }
+    m_concurrency = concurrency;
+}
+
+size_t ImageResizer::getConcurrency() const {
+    return m_concurrency;
+}
+
+Image ImageResizer::resize(const ImageView& source, int32_t width, int32_t height, ImageAllocator* allocator) const {
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("Resize target " + std::to_string(width) + "x" + std::to_string(height) + " must have positive dimensions");
+    }
+    Image image(width, height, source.getChannels(), 0, allocator);
+    resize(source, image.getMutableBuffer(), width, height, image.getStride());
+    return image;
+}
+
+void ImageResizer::resize(const ImageView& source, uint8_t* destination, int32_t width, int32_t height, size_t stride) const {
+    if (source.getSampleType() != Image::SampleType::U8) {
+        throw std::invalid_argument("Resizing requires 8-bit samples");
+    }
+    if (source.getChannels() < 1 || source.getChannels() > 4) {
+        throw std::invalid_argument("Resizing requires 1 to 4 channels, got " + std::to_string(source.getChannels()));
+    }
+    if (source.getWidth() <= 0 || source.getHeight() <= 0) {
+        throw std::invalid_argument("Cannot resize an empty image");
+    }
+    if (width <= 0 || height <= 0) {
+        throw std::invalid_argument("Resize target " + std::to_string(width) + "x" + std::to_string(height) + " must have positive dimensions");
+    }
+    const size_t row_size = static_cast<size_t>(width) * source.getChannels();
+    if (stride == 0) {
+        stride = row_size;
+    }
+    if (stride < row_size) {
+        throw std::invalid_argument("Resize target stride is smaller than a row");
+    }
+
+    // RGB windows read up to 4 bytes past their end, i.e. 2 pixels.
+    const int32_t channels = source.getChannels();
+    const Coefficients horizontal = computeCoefficients(source.getWidth(), width, m_filter, horizontalAlignment(channels), channels == 3 ? 2 : 0);
+    const Coefficients vertical = computeCoefficients(source.getHeight(), height, m_filter, 1, 0);
+
+    // Size the strips so that their intermediate rows stay in cache. Each thread resizes a run of
+    // neighbouring strips, so source rows are filtered horizontally once, except at the ends of runs.
+    const size_t intermediate_row = row_size * sizeof(int16_t);
+    const int32_t rows_per_target_row = std::max(1, (source.getHeight() + height - 1) / height);
+    const int32_t budget_rows = static_cast<int32_t>(std::clamp<size_t>(STRIP_BUDGET / intermediate_row, 1, static_cast<size_t>(height) * rows_per_target_row));
+    const int32_t strip_height = std::max(1, (budget_rows - vertical.taps) / rows_per_target_row);
+    const int32_t strip_count = (height + strip_height - 1) / strip_height;
+    const int32_t runs = static_cast<int32_t>(std::min<size_t>(m_concurrency, strip_count));
+
+    if (! m_pool || runs == 1) {
+        resizeStrips(source, destination, stride, horizontal, vertical, width, height, strip_height, 0, strip_count);
+        return;
+    }
+
+    std::latch done(runs);
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+    auto resizeRun = [&](int32_t first, int32_t last) {
+        try {
+            resizeStrips(source, destination, stride, horizontal, vertical, width, height, strip_height, first, last);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            exception = std::current_exception();
+        }
+        done.count_down();
+    };
+    for (int32_t run = 0; run < runs; run++) {
+        const int32_t first = static_cast<int32_t>(static_cast<int64_t>(strip_count) * run / runs);
+        const int32_t last = static_cast<int32_t>(static_cast<int64_t>(strip_count) * (run + 1) / runs);
+        try {
+            m_pool->submit([&resizeRun, first, last] { resizeRun(first, last); });
+        } catch (...) {
+            // The run was not queued. Resize it here instead, since the queued runs refer to this
+            // frame and every run must have counted down before it is left.
+            resizeRun(first, last);
+        }
+    }
+    done.wait();
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
@@ -0,0 +1,102 @@
+#include <stdexcept>
+#include <string>
+
+#include "image-view.h"
+
+/**
+ * @brief Default constructor that initializes an empty view.
+ */
+ImageView::ImageView() : m_buffer(nullptr), m_width(0), m_height(0), m_channels(0), m_sample_type(Image::SampleType::U8), m_stride(0) {}
+
+/**
+ * @brief Constructs a view of a raw pixel buffer.
+ */
+ImageView::ImageView(const uint8_t* buffer, int32_t width, int32_t height, int32_t channels, size_t stride)
+    : ImageView(buffer, width, height, channels, Image::SampleType::U8, stride) {}
+
+/**
+ * @brief Constructs a view of a raw buffer of samples of the specified type.
+ */
+ImageView::ImageView(const uint8_t* buffer, int32_t width, int32_t height, int32_t channels, Image::SampleType sample_type, size_t stride)
+    : m_buffer(buffer), m_width(width), m_height(height), m_channels(channels), m_sample_type(sample_type),
+      m_stride(Image::packedStride(width, channels, sample_type, stride)) {}
+
+/**
+ * @brief Constructs a view of all pixels of an image.
+ */
+ImageView::ImageView(const Image& image)
+    : m_buffer(image.getBuffer()), m_width(image.getWidth()), m_height(image.getHeight()), m_channels(image.getChannels()),
+      m_sample_type(image.getSampleType()), m_stride(image.getStride()) {}
+
+/**
+ * @brief Retrieves a view of a rectangle within this view.
+ */
+ImageView ImageView::crop(int32_t x, int32_t y, int32_t width, int32_t height) const {
+    if (x < 0 || y < 0 || width < 0 || height < 0
+        || static_cast<int64_t>(x) + width > m_width || static_cast<int64_t>(y) + height > m_height) {
+        throw std::out_of_range("Crop rectangle " + std::to_string(width) + "x" + std::to_string(height) + " at ("
+            + std::to_string(x) + ", " + std::to_string(y) + ") is outside of the "
+            + std::to_string(m_width) + "x" + std::to_string(m_height) + " image");
+    }
+    const uint8_t* buffer = m_buffer ? m_buffer + y * m_stride + static_cast<size_t>(x) * m_channels * Image::getSampleSize(m_sample_type) : nullptr;
+    return ImageView(buffer, width, height, m_channels, m_sample_type, m_stride);
+}
+
+/**
+ * @brief Retrieves a pointer to the first pixel of the view.
+ */
+const uint8_t* ImageView::getBuffer() const {
+    return m_buffer;
+}
+
+/**
+ * @brief Retrieves a pointer to the first pixel of a row.
+ */
+const uint8_t* ImageView::getRow(int32_t y) const {
+    return m_buffer + y * m_stride;
+}
+
+/**
+ * @brief Retrieves the span of the viewed buffer in bytes.
+ */
+size_t ImageView::getBufferSize() const {
+    if (m_height <= 0) {
+        return 0;
+    }
+    return m_stride * (m_height - 1) + static_cast<size_t>(m_width) * m_channels * Image::getSampleSize(m_sample_type);
+}
+
+/**
+ * @brief Retrieves the width of the view.
+ */
+int32_t ImageView::getWidth() const {
+    return m_width;
+}
+
+/**
+ * @brief Retrieves the height of the view.
+ */
+int32_t ImageView::getHeight() const {
+    return m_height;
+}
+
+/**
+ * @brief Retrieves the number of channels per pixel.
+ */
+int32_t ImageView::getChannels() const {
+    return m_channels;
+}
+
+/**
+ * @brief Retrieves the type of each channel sample.
+ */
+Image::SampleType ImageView::getSampleType() const {
+    return m_sample_type;
+}
+
+/**
+ * @brief Retrieves the row stride in bytes.
+ */
+size_t ImageView::getStride() const {
+    return m_stride;
+}
@@ -1,45 +1,105 @@
+#include <atomic>
+
 #include "image.h"
+#include "image-view.h"
+
+/**
+ * @brief Reference counted owner of a buffer shared between images, holding its original ownership.
+ */
+struct Image::SharedBuffer {
+    std::atomic<size_t> references;     // Number of images sharing the buffer.
+    Ownership ownership;                // How the buffer is released once the last image lets go of it.
+    DeallocateFunction deallocate;      // Deallocator for Ownership::Function.
+    void* context;                      // Allocator or deallocator context.
+    void (*free)(void*);                // Deallocator for Ownership::FreeFunction.
+};
 
 /**
  * @brief Default constructor that initializes an empty image.
  */
-Image::Image() : m_buffer(nullptr), m_width(0), m_height(0), m_channels(0), m_deallocator(nullptr) {}
+Image::Image()
+    : m_buffer(nullptr), m_width(0), m_height(0), m_channels(0), m_ownership(Ownership::Array), m_sample_type(SampleType::U8), m_stride(0), m_deallocate(nullptr), m_context(nullptr) {}
 
 /**
  * @brief Constructs an image with a specified buffer, width, height, and channels.
  */
-Image::Image(const uint8_t* buffer, int32_t width, int32_t height, int32_t channels)
-    : m_buffer(nullptr), m_width(width), m_height(height), m_channels(channels), m_deallocator(nullptr) {
-    size_t buffer_size = static_cast<size_t>(width) * height * channels;
-    m_buffer = new uint8_t[buffer_size];
-    std::memcpy(m_buffer, buffer, buffer_size);
+Image::Image(const uint8_t* buffer, int32_t width, int32_t height, int32_t channels, ImageAllocator* allocator)
+    : m_buffer(nullptr), m_width(width), m_height(height), m_channels(channels), m_ownership(Ownership::Array), m_sample_type(SampleType::U8),
+      m_stride(packedStride(width, channels, SampleType::U8, 0)), m_deallocate(nullptr), m_context(nullptr) {
+    allocateCopy(buffer, m_stride, allocator ? *allocator : ImageAllocator::getDefault());
+}
+
+/**
+ * @brief Constructs an image with an uninitialized buffer of the specified dimensions.
+ */
+Image::Image(int32_t width, int32_t height, int32_t channels, size_t stride, ImageAllocator* allocator)
+    : Image(width, height, channels, SampleType::U8, stride, allocator) {}
+
+/**
+ * @brief Constructs an image with an uninitialized buffer of the specified dimensions and sample type.
+ */
+Image::Image(int32_t width, int32_t height, int32_t channels, SampleType sample_type, size_t stride, ImageAllocator* allocator)
+    : m_buffer(nullptr), m_width(width), m_height(height), m_channels(channels), m_ownership(Ownership::Array), m_sample_type(sample_type),
+      m_stride(packedStride(width, channels, sample_type, stride)), m_deallocate(nullptr), m_context(nullptr) {
+    allocate(allocator ? *allocator : ImageAllocator::getDefault());
+}
+
+/**
+ * @brief Constructs an image with a tightly packed copy of the pixels of a view.
+ */
+Image::Image(const ImageView& view, ImageAllocator* allocator)
+    : m_buffer(nullptr), m_width(view.getWidth()), m_height(view.getHeight()), m_channels(view.getChannels()), m_ownership(Ownership::Array),
+      m_sample_type(view.getSampleType()), m_stride(packedStride(view.getWidth(), view.getChannels(), view.getSampleType(), 0)), m_deallocate(nullptr), m_context(nullptr) {
+    allocateCopy(view.getBuffer(), view.getStride(), allocator ? *allocator : ImageAllocator::getDefault());
 }
 
 /**
- * @brief Constructs an image with a specified buffer and deallocator.
+ * @brief Constructs an image with a specified buffer, deallocator function and context.
  */
-Image::Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, std::function<void(void*)> deallocator)
-    : m_buffer(buffer), m_width(width), m_height(height), m_channels(channels), m_deallocator(deallocator) {}
+Image::Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, DeallocateFunction deallocate, void* context)
+    : Image(buffer, width, height, channels, 0, deallocate, context) {}
+
+/**
+ * @brief Constructs an image with a specified buffer with padded rows, deallocator function and context.
+ */
+Image::Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, size_t stride, DeallocateFunction deallocate, void* context)
+    : Image(buffer, width, height, channels, SampleType::U8, stride, deallocate, context) {}
+
+/**
+ * @brief Constructs an image with a specified buffer of samples of the specified type, deallocator function and context.
+ */
+Image::Image(uint8_t* buffer, int32_t width, int32_t height, int32_t channels, SampleType sample_type, size_t stride, DeallocateFunction deallocate, void* context)
+    : m_buffer(buffer), m_width(width), m_height(height), m_channels(channels), m_ownership(deallocate ? Ownership::Function : Ownership::Array),
+      m_sample_type(sample_type), m_stride(packedStride(width, channels, sample_type, stride)), m_deallocate(deallocate), m_context(context) {}
 
 /**
  * @brief Copy constructor that performs a deep copy of the image.
  */
 Image::Image(const Image& other)
-    : m_width(other.m_width), m_height(other.m_height), m_channels(other.m_channels), m_deallocator(nullptr) {
-    size_t buffer_size = static_cast<size_t>(m_width) * m_height * m_channels;
-    m_buffer = new uint8_t[buffer_size];
-    std::memcpy(m_buffer, other.m_buffer, buffer_size);
+    : m_buffer(nullptr), m_width(other.m_width), m_height(other.m_height), m_channels(other.m_channels),
+      m_ownership(Ownership::Array), m_sample_type(other.m_sample_type), m_stride(packedStride(other.m_width, other.m_channels, other.m_sample_type, 0)), m_deallocate(nullptr), m_context(nullptr) {
+    if (other.m_ownership == Ownership::Shared) {
+        static_cast<SharedBuffer*>(other.m_context)->references.fetch_add(1, std::memory_order_relaxed);
+        m_buffer = other.m_buffer;
+        m_ownership = Ownership::Shared;
+        m_stride = other.m_stride;
+        m_context = other.m_context;
+        return;
+    }
+    allocateCopy(other.m_buffer, other.m_stride, other.getCopyAllocator());
 }
 
 /**
  * @brief Move constructor that transfers ownership of resources.
  */
 Image::Image(Image&& other) noexcept
-    : m_buffer(other.m_buffer), m_width(other.m_width), m_height(other.m_height), m_channels(other.m_channels), m_deallocator(std::move(other.m_deallocator)) {
+    : m_buffer(other.m_buffer), m_width(other.m_width), m_height(other.m_height), m_channels(other.m_channels),
+      m_ownership(other.m_ownership), m_sample_type(other.m_sample_type), m_stride(other.m_stride), m_deallocate(other.m_deallocate), m_context(other.m_context) {
     other.m_buffer = nullptr;
     other.m_width = 0;
     other.m_height = 0;
     other.m_channels = 0;
+    other.m_stride = 0;
 }
 
 /**
@@ -47,20 +107,8 @@ Image::Image(Image&& other) noexcept
  */
 Image& Image::operator=(const Image& other) {
     if (this != &other) {
-        if (m_buffer && m_deallocator) {
-            m_deallocator(m_buffer);
-        } else {
-            delete[] m_buffer;
-        }
-
-        m_width = other.m_width;
-        m_height = other.m_height;
-        m_channels = other.m_channels;
-        m_deallocator = nullptr;
-
-        size_t buffer_size = static_cast<size_t>(m_width) * m_height * m_channels;
-        m_buffer = new uint8_t[buffer_size];
-        std::memcpy(m_buffer, other.m_buffer, buffer_size);
+        // Copy into a temporary first, so the image is left untouched if the allocation fails.
+        *this = Image(other);
     }
     return *this;
 }
@@ -70,26 +118,122 @@ Image& Image::operator=(const Image& other) {
  */
 Image& Image::operator=(Image&& other) noexcept {
     if (this != &other) {
-        if (m_buffer && m_deallocator) {
-            m_deallocator(m_buffer);
-        } else {
-            delete[] m_buffer;
-        }
+        release();
 
         m_buffer = other.m_buffer;
         m_width = other.m_width;
         m_height = other.m_height;
         m_channels = other.m_channels;
-        m_deallocator = std::move(other.m_deallocator);
+        m_stride = other.m_stride;
+        m_ownership = other.m_ownership;
+        m_sample_type = other.m_sample_type;
+        m_deallocate = other.m_deallocate;
+        m_context = other.m_context;
 
         other.m_buffer = nullptr;
         other.m_width = 0;
         other.m_height = 0;
         other.m_channels = 0;
+        other.m_stride = 0;
     }
     return *this;
 }
 
+/**
+ * @brief Releases the buffer according to the ownership.
+ */
+void Image::release() noexcept {
+    if (! m_buffer) {
+        return;
+    }
+    if (m_ownership == Ownership::Shared) {
+        auto* shared = static_cast<SharedBuffer*>(m_context);
+        if (shared->references.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+
+        // Last image sharing the buffer; release it the way it was originally owned.
+        m_ownership = shared->ownership;
+        m_deallocate = shared->deallocate;
+        if (m_ownership == Ownership::FreeFunction) {
+            m_free = shared->free;
+        } else {
+            m_context = shared->context;
+        }
+        delete shared;
+    }
+    switch (m_ownership) {
+        case Ownership::Array:
+            delete[] m_buffer;
+            break;
+        case Ownership::Allocator:
+            static_cast<ImageAllocator*>(m_context)->deallocate(m_buffer, getAllocationSize());
+            break;
+        case Ownership::FreeFunction:
+            m_free(m_buffer);
+            break;
+        case Ownership::Function:
+            m_deallocate(m_buffer, m_context);
+            break;
+        case Ownership::Shared:
+            break;
+    }
+}
+
+/**
+ * @brief Retrieves the allocator that copies of the buffer are allocated from.
+ */
+ImageAllocator& Image::getCopyAllocator() const {
+    if (m_ownership == Ownership::Allocator) {
+        return *static_cast<ImageAllocator*>(m_context);
+    }
+    if (m_ownership == Ownership::Shared) {
+        auto* shared = static_cast<SharedBuffer*>(m_context);
+        if (shared->ownership == Ownership::Allocator) {
+            return *static_cast<ImageAllocator*>(shared->context);
+        }
+    }
+    return ImageAllocator::getDefault();
+}
+
+/**
+ * @brief Retrieves the number of bytes allocated for the buffer by the image itself.
+ */
+size_t Image::getAllocationSize() const {
+    // Whole rows, so that kernels may process the padding of the last row like any other.
+    return m_height > 0 ? m_stride * m_height : 0;
+}
+
+/**
+ * @brief Allocates the buffer from an allocator.
+ */
+void Image::allocate(ImageAllocator& allocator) {
+    m_buffer = static_cast<uint8_t*>(allocator.allocate(getAllocationSize()));
+    if (! m_buffer) {
+        throw std::bad_alloc();
+    }
+    m_ownership = Ownership::Allocator;
+    m_context = &allocator;
+}
+
+/**
+ * @brief Allocates the buffer from an allocator and copies the rows of another buffer into it.
+ */
+void Image::allocateCopy(const uint8_t* buffer, size_t stride, ImageAllocator& allocator) {
+    allocate(allocator);
+    if (stride == m_stride) {
+        size_t buffer_size = getBufferSize();
+        if (buffer_size) {
+            std::memcpy(m_buffer, buffer, buffer_size);
+        }
+    } else {
+        size_t row_size = static_cast<size_t>(m_width) * m_channels * getSampleSize(m_sample_type);
+        for (int32_t y = 0; y < m_height; y++) {
+            std::memcpy(m_buffer + y * m_stride, buffer + y * stride, row_size);
+        }
+    }
+}
+
 /**
  * @brief Retrieves the image data buffer.
  */
@@ -97,11 +241,73 @@ const uint8_t* Image::getBuffer() const {
     return m_buffer;
 }
 
+/**
+ * @brief Retrieves the image data buffer for writing.
+ */
+uint8_t* Image::getMutableBuffer() {
+    if (m_ownership == Ownership::Shared && static_cast<SharedBuffer*>(m_context)->references.load(std::memory_order_acquire) != 1) {
+        // Copy-on-write: detach into a private buffer with the same layout.
+        Image copy(m_width, m_height, m_channels, m_sample_type, m_stride, &getCopyAllocator());
+        size_t buffer_size = getBufferSize();
+        if (buffer_size) {
+            std::memcpy(copy.m_buffer, m_buffer, buffer_size);
+        }
+        *this = std::move(copy);
+        makeShared();
+    }
+    return m_buffer;
+}
+
+/**
+ * @brief Switches the image to shared mode.
+ */
+void Image::makeShared() {
+    if (! m_buffer || m_ownership == Ownership::Shared) {
+        return;
+    }
+
+    auto* shared = new SharedBuffer;
+    shared->references.store(1, std::memory_order_relaxed);
+    shared->ownership = m_ownership;
+    shared->deallocate = m_deallocate;
+    shared->context = m_ownership == Ownership::FreeFunction ? nullptr : m_context;
+    shared->free = m_ownership == Ownership::FreeFunction ? m_free : nullptr;
+
+    m_ownership = Ownership::Shared;
+    m_deallocate = nullptr;
+    m_context = shared;
+}
+
+/**
+ * @brief Checks whether the image is in shared mode.
+ */
+bool Image::isShared() const {
+    return m_ownership == Ownership::Shared;
+}
+
 /**
  * @brief Retrives the buffer size in bytes.
  */
 size_t Image::getBufferSize() const {
-    return static_cast<size_t>(m_width) * m_height * m_channels;
+    if (m_height <= 0) {
+        return 0;
+    }
+    return m_stride * (m_height - 1) + static_cast<size_t>(m_width) * m_channels * getSampleSize(m_sample_type);
+}
+
+/**
+ * @brief Retrieves the row stride in bytes.
+ */
+size_t Image::getStride() const {
+    return m_stride;
+}
+
+/**
+ * @brief Computes the smallest aligned stride for a row.
+ */
+size_t Image::alignedStride(int32_t width, int32_t channels, SampleType sample_type) {
+    size_t row_size = static_cast<size_t>(width) * channels * getSampleSize(sample_type);
+    return (row_size + ImageAllocator::ALIGNMENT - 1) / ImageAllocator::ALIGNMENT * ImageAllocator::ALIGNMENT;
 }
 
 /**
@@ -125,15 +331,16 @@ int32_t Image::getChannels() const {
     return m_channels;
 }
 
+/**
+ * @brief Retrieves the type of each channel sample.
+ */
+Image::SampleType Image::getSampleType() const {
+    return m_sample_type;
+}
+
 /**
  * @brief Destructor that releases the allocated buffer memory.
  */
 Image::~Image() {
-    if (m_buffer) {
-        if (m_deallocator) {
-            m_deallocator(m_buffer);
-        } else {
-            delete[] m_buffer;
-        }
-    }
+    release();
 }
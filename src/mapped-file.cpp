@@ -0,0 +1,79 @@
+#include <stdexcept>
+
+#include "mapped-file.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define IMAGE_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define IMAGE_HAS_MMAP 0
+#endif
+
+/**
+ * @brief Checks whether memory mapping is available on this platform.
+ */
+bool MappedFile::isSupported() {
+    return IMAGE_HAS_MMAP;
+}
+
+#if IMAGE_HAS_MMAP
+
+/**
+ * @brief Maps the file at the specified path.
+ */
+MappedFile::MappedFile(const std::string& filepath) : m_data(nullptr), m_size(0) {
+    int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error(std::string("Failed to open file at ") + filepath);
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+        close(fd);
+        throw std::runtime_error(std::string("Failed to map empty or unreadable file at ") + filepath);
+    }
+    m_size = static_cast<size_t>(status.st_size);
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file.
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        throw std::runtime_error(std::string("Failed to map file at ") + filepath);
+    }
+    m_data = static_cast<uint8_t*>(data);
+
+    // Only a hint, so failure is harmless.
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+}
+
+/**
+ * @brief Destructor that unmaps the file.
+ */
+MappedFile::~MappedFile() {
+    munmap(m_data, m_size);
+}
+
+#else
+
+/**
+ * @brief Memory mapping is unavailable on this platform.
+ */
+MappedFile::MappedFile(const std::string& filepath) : m_data(nullptr), m_size(0) {
+    throw std::runtime_error(std::string("Memory mapping is not supported, cannot map ") + filepath);
+}
+
+MappedFile::~MappedFile() = default;
+
+#endif
+
+/**
+ * @brief Retrieves the contents of the file.
+ */
+std::span<const uint8_t> MappedFile::getData() const {
+    return std::span<const uint8_t>(m_data, m_size);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+/**
+ * @class MappedFile
+ * @brief A read-only memory mapping of a whole file.
+ * 
+ * The mapping is advised for sequential access, so the kernel reads ahead aggressively while the
+ * contents are consumed front to back. Objects of this class are non-copyable.
+ */
+class MappedFile {
+    uint8_t* m_data;    // Start of the mapping.
+    size_t m_size;      // Size of the mapping in bytes.
+
+public:
+    /**
+     * @brief Checks whether memory mapping is available on this platform.
+     * 
+     * @return True if files can be mapped, false otherwise.
+     */
+    static bool isSupported();
+
+    /**
+     * @brief Maps the file at the specified path. Throws std::runtime_error on failure.
+     * 
+     * @param filepath The file path of the file to map.
+     */
+    explicit MappedFile(const std::string& filepath);
+
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+
+    /**
+     * @brief Destructor that unmaps the file.
+     */
+    ~MappedFile();
+
+    /**
+     * @brief Retrieves the contents of the file.
+     * 
+     * @return The mapped bytes, valid as long as the object is alive.
+     */
+    std::span<const uint8_t> getData() const;
+};
@@ -0,0 +1,168 @@
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+#include "stb-allocator.h"
+
+namespace {
+
+/**
+ * @brief Header placed in front of every block, so its capacity and allocator are known when it is freed.
+ */
+struct alignas(std::max_align_t) BlockHeader {
+    size_t capacity;            // Usable size of the block in bytes, excluding the header.
+    ImageAllocator* allocator;  // Allocator the block came from.
+};
+
+/**
+ * @brief Space reserved for the header in front of every block. Padding the header to the allocator
+ * alignment keeps the memory handed to stb_image, including decoded pixels, equally aligned.
+ */
+constexpr size_t HEADER_SIZE = ImageAllocator::ALIGNMENT;
+static_assert(sizeof(BlockHeader) <= HEADER_SIZE);
+
+/**
+ * @brief Converts between a block and the memory handed out for it.
+ */
+void* payload(BlockHeader* block) {
+    return reinterpret_cast<uint8_t*>(block) + HEADER_SIZE;
+}
+
+BlockHeader* header(void* pointer) {
+    return reinterpret_cast<BlockHeader*>(static_cast<uint8_t*>(pointer) - HEADER_SIZE);
+}
+
+/**
+ * @brief Maximum number of freed blocks kept per thread.
+ */
+constexpr size_t CACHED_BLOCK_COUNT = 16;
+
+/**
+ * @brief Maximum number of bytes kept in freed blocks per thread.
+ */
+constexpr size_t CACHED_BYTES_LIMIT = size_t(64) << 20;
+
+/**
+ * @brief Per-thread allocation state: the active scope and the cache of freed default allocator
+ * blocks. Cached blocks are released when the thread exits.
+ */
+struct ThreadState {
+    BlockHeader* blocks[CACHED_BLOCK_COUNT] = {};
+    size_t count = 0;
+    size_t bytes = 0;
+    bool scope_active = false;
+    ImageAllocator* scope_allocator = nullptr;
+
+    ~ThreadState() {
+        for (size_t i = 0; i < count; i++) {
+            release(blocks[i]);
+        }
+    }
+
+    /**
+     * @brief Takes the smallest cached block that fits `size` without wasting more than half of it.
+     */
+    BlockHeader* take(size_t size) {
+        size_t best = count;
+        for (size_t i = 0; i < count; i++) {
+            size_t capacity = blocks[i]->capacity;
+            if (capacity >= size && capacity / 2 <= size && (best == count || capacity < blocks[best]->capacity)) {
+                best = i;
+            }
+        }
+        if (best == count) {
+            return nullptr;
+        }
+
+        BlockHeader* block = blocks[best];
+        blocks[best] = blocks[--count];
+        bytes -= block->capacity;
+        return block;
+    }
+
+    /**
+     * @brief Keeps a block for reuse if the cache has room for it.
+     */
+    bool put(BlockHeader* block) {
+        if (count == CACHED_BLOCK_COUNT || block->capacity > CACHED_BYTES_LIMIT - bytes) {
+            return false;
+        }
+        blocks[count++] = block;
+        bytes += block->capacity;
+        return true;
+    }
+
+    /**
+     * @brief Returns a block to the allocator it came from.
+     */
+    static void release(BlockHeader* block) {
+        block->allocator->deallocate(block, HEADER_SIZE + block->capacity);
+    }
+};
+
+thread_local ThreadState state;
+
+} // namespace
+
+void* stbAllocate(size_t size) {
+    ImageAllocator* allocator = state.scope_allocator;
+    bool cached = state.scope_active && ! allocator;
+    if (! allocator) {
+        allocator = &ImageAllocator::getDefault();
+    }
+
+    BlockHeader* block = cached ? state.take(size) : nullptr;
+    if (! block) {
+        block = static_cast<BlockHeader*>(allocator->allocate(HEADER_SIZE + size));
+        if (! block) {
+            return nullptr;
+        }
+        block->capacity = size;
+        block->allocator = allocator;
+    }
+    return payload(block);
+}
+
+void* stbReallocate(void* pointer, size_t old_size, size_t new_size) {
+    if (! pointer) {
+        return stbAllocate(new_size);
+    }
+
+    BlockHeader* block = header(pointer);
+    if (block->capacity >= new_size) {
+        return pointer;
+    }
+
+    void* grown = stbAllocate(new_size);
+    if (! grown) {
+        return nullptr;
+    }
+    std::memcpy(grown, pointer, old_size < new_size ? old_size : new_size);
+    stbFree(pointer);
+
+    return grown;
+}
+
+void stbFree(void* pointer) {
+    if (! pointer) {
+        return;
+    }
+
+    // Only default allocator blocks are cached; custom allocators do their own recycling.
+    BlockHeader* block = header(pointer);
+    bool cached = state.scope_active && ! state.scope_allocator && block->allocator == &ImageAllocator::getDefault();
+    if (! cached || ! state.put(block)) {
+        ThreadState::release(block);
+    }
+}
+
+StbAllocationScope::StbAllocationScope(ImageAllocator* allocator)
+    : m_previous_allocator(state.scope_allocator), m_previous_active(state.scope_active) {
+    state.scope_active = true;
+    state.scope_allocator = allocator;
+}
+
+StbAllocationScope::~StbAllocationScope() {
+    state.scope_active = m_previous_active;
+    state.scope_allocator = m_previous_allocator;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+#include "image-allocator.h"
+
+/**
+ * @brief Memory hooks that stb_image is compiled with (STBI_MALLOC, STBI_REALLOC_SIZED and STBI_FREE).
+ * 
+ * Outside of an StbAllocationScope they allocate from the default allocator. Inside a scope, memory comes
+ * from the scope's allocator; with the default allocator, freed blocks are kept in a per-thread cache
+ * and handed out again for later requests of a similar size, so that repeated decodes of similarly
+ * sized images stop allocating once the cache is warm. Every block remembers its allocator, so blocks
+ * may be freed on any thread, inside or outside of a scope.
+ */
+void* stbAllocate(size_t size);
+void* stbReallocate(void* pointer, size_t old_size, size_t new_size);
+void stbFree(void* pointer);
+
+/**
+ * @class StbAllocationScope
+ * @brief Routes stb_image allocations made on the current thread while the object is alive.
+ * Scopes may be nested; the innermost one applies. Objects of this class are non-copyable.
+ */
+class StbAllocationScope {
+    ImageAllocator* m_previous_allocator;   // Allocator of the enclosing scope.
+    bool m_previous_active;                 // Whether there is an enclosing scope.
+
+public:
+    /**
+     * @brief Routes allocations to the specified allocator, or to the cached default allocator if it is null.
+     * 
+     * @param allocator The allocator to use, or nullptr.
+     */
+    explicit StbAllocationScope(ImageAllocator* allocator = nullptr);
+    ~StbAllocationScope();
+
+    StbAllocationScope(const StbAllocationScope& other) = delete;
+    StbAllocationScope& operator=(const StbAllocationScope& other) = delete;
+};
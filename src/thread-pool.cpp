@@ -0,0 +1,103 @@
+#include "thread-pool.h"
+
+/**
+ * @brief Starts a pool with the specified number of worker threads.
+ */
+ThreadPool::ThreadPool(size_t thread_count, size_t queue_capacity)
+    : m_queue_capacity(0), m_active_tasks(0), m_stopping(false) {
+    if (thread_count == 0) {
+        thread_count = defaultThreadCount();
+    }
+    m_queue_capacity = queue_capacity ? queue_capacity : thread_count * 2;
+
+    m_workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++) {
+        m_workers.emplace_back(&ThreadPool::run, this);
+    }
+}
+
+/**
+ * @brief Finishes all pending tasks and joins the worker threads.
+ */
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_task_available.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+/**
+ * @brief Queues a task for execution, blocking while the queue is full.
+ */
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_space_available.wait(lock, [this] { return m_tasks.size() < m_queue_capacity; });
+        m_tasks.push_back(std::move(task));
+    }
+    m_task_available.notify_one();
+}
+
+/**
+ * @brief Blocks until every submitted task has finished executing.
+ */
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_tasks.empty() && m_active_tasks == 0; });
+}
+
+/**
+ * @brief Retrieves the number of worker threads.
+ */
+size_t ThreadPool::getThreadCount() const {
+    return m_workers.size();
+}
+
+/**
+ * @brief Retrieves the number of threads used when no explicit count is given.
+ */
+size_t ThreadPool::defaultThreadCount() {
+    unsigned int count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+/**
+ * @brief Worker loop: executes queued tasks until the pool is stopped and the queue is drained.
+ */
+void ThreadPool::run() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_task_available.wait(lock, [this] { return m_stopping || ! m_tasks.empty(); });
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            m_active_tasks++;
+        }
+        m_space_available.notify_one();
+
+        try {
+            task();
+        } catch (...) {
+            // Tasks are expected to report their own errors.
+        }
+
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_active_tasks--;
+            idle = m_tasks.empty() && m_active_tasks == 0;
+        }
+        if (idle) {
+            m_idle.notify_all();
+        }
+    }
+}
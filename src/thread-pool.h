@@ -0,0 +1,131 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class ThreadPool
+ * @brief A fixed-size pool of worker threads executing tasks from a bounded queue.
+ * 
+ * Submitting a task blocks while the queue is full, which applies back-pressure to producers
+ * that generate work faster than the workers can finish it. Tasks must not throw; an exception
+ * escaping a task is swallowed so that it cannot take down the worker thread.
+ * Objects of this class are non-copyable.
+ */
+class ThreadPool {
+    std::vector<std::thread> m_workers;         // Worker threads.
+    std::deque<std::function<void()>> m_tasks;  // Pending tasks.
+    size_t m_queue_capacity;                    // Maximum number of pending tasks.
+    size_t m_active_tasks;                      // Number of tasks currently being executed.
+    bool m_stopping;                            // Set when the pool is being destroyed.
+    std::mutex m_mutex;                         // Guards all of the above.
+    std::condition_variable m_task_available;   // Signaled when a task is queued or the pool stops.
+    std::condition_variable m_space_available;  // Signaled when a task is taken off the queue.
+    std::condition_variable m_idle;             // Signaled when the pool runs out of work.
+
+public:
+    /**
+     * @brief Starts a pool with the specified number of worker threads.
+     * 
+     * @param thread_count Number of worker threads. Zero selects ThreadPool::defaultThreadCount().
+     * @param queue_capacity Maximum number of pending tasks. Zero selects twice the number of threads.
+     */
+    explicit ThreadPool(size_t thread_count = 0, size_t queue_capacity = 0);
+
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    /**
+     * @brief Finishes all pending tasks and joins the worker threads.
+     */
+    ~ThreadPool();
+
+    /**
+     * @brief Queues a task for execution, blocking while the queue is full.
+     * 
+     * @param task The task to execute.
+     */
+    void submit(std::function<void()> task);
+
+    /**
+     * @brief Blocks until every submitted task has finished executing.
+     */
+    void wait();
+
+    /**
+     * @brief Retrieves the number of worker threads.
+     * 
+     * @return Number of worker threads.
+     */
+    size_t getThreadCount() const;
+
+    /**
+     * @brief Retrieves the number of threads used when no explicit count is given.
+     * 
+     * @return The number of hardware threads, or 1 if it cannot be determined.
+     */
+    static size_t defaultThreadCount();
+
+private:
+    void run();
+};
+
+/**
+ * @brief Runs `item(index, result)` for every item of a batch on a pool of worker threads of its own,
+ * and returns one result per item, in order.
+ * 
+ * Even a single worker is a pool thread, so items may change thread-local state without affecting
+ * the calling thread. An exception escaping an item is stored as the error of its result rather
+ * than ending the batch. `progress`, if set, is called after each item with the number of finished
+ * items and the total; the calls are serialized.
+ * 
+ * @param count Number of items in the batch.
+ * @param concurrency Number of worker threads, at most one per item. Zero selects ThreadPool::defaultThreadCount().
+ * @return The results, each with an `error` string that is empty if the item succeeded.
+ */
+template <typename Result, typename Item>
+std::vector<Result> runBatch(size_t count, size_t concurrency, const Item& item, const std::function<void(size_t completed, size_t total)>& progress) {
+    std::vector<Result> results(count);
+    if (count == 0) {
+        return results;
+    }
+
+    size_t completed = 0;
+    std::mutex progress_mutex;
+    auto runItem = [&](size_t index) {
+        try {
+            item(index, results[index]);
+        } catch (const std::exception& exception) {
+            results[index].error = exception.what();
+        } catch (...) {
+            results[index].error = "Unknown error";
+        }
+
+        if (progress) {
+            std::lock_guard<std::mutex> lock(progress_mutex);
+            progress(++completed, count);
+        }
+    };
+
+    if (concurrency == 0) {
+        concurrency = ThreadPool::defaultThreadCount();
+    }
+    if (concurrency > count) {
+        concurrency = count;
+    }
+
+    // The pool is destroyed before the locals its tasks refer to, and finishes them first.
+    ThreadPool pool(concurrency);
+    for (size_t i = 0; i < count; i++) {
+        pool.submit([&runItem, i] { runItem(i); });
+    }
+    pool.wait();
+
+    return results;
+}
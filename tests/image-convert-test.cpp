@@ -0,0 +1,139 @@
+#include "../src/image-convert.cpp"
+
+#include <random>
+
+#include "test-support.h"
+
+namespace {
+
+/**
+ * @brief Row widths covering empty rows, every remainder of the vector loops and several full
+ * vectors of the widest tier.
+ */
+constexpr int32_t MAX_WIDTH = 140;
+
+std::vector<uint8_t> randomRow(std::mt19937& random, size_t size) {
+    std::vector<uint8_t> row(size);
+    for (uint8_t& sample : row) {
+        sample = static_cast<uint8_t>(random());
+    }
+    return row;
+}
+
+/**
+ * @brief Checks that a row kernel writes exactly what the scalar one does, for every width.
+ */
+void checkRowKernel(std::mt19937& random, RowKernel kernel, RowKernel scalar, int32_t source_channels, int32_t target_channels, const char* description) {
+    for (int32_t width = 0; width < MAX_WIDTH; width++) {
+        // Exactly sized rows, so that reads or writes past the end trip memory checkers.
+        std::vector<uint8_t> source = randomRow(random, static_cast<size_t>(width) * source_channels);
+        std::vector<uint8_t> expected(static_cast<size_t>(width) * target_channels);
+        std::vector<uint8_t> actual(expected.size());
+        scalar(source.data(), expected.data(), width);
+        kernel(source.data(), actual.data(), width);
+        if (actual != expected) {
+            check(false, description);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Checks that a luma kernel writes exactly what the scalar one does, for every width and
+ * both sets of weights.
+ */
+void checkLumaKernel(std::mt19937& random, LumaKernel kernel, LumaKernel scalar, int32_t source_channels, const char* description) {
+    for (const int16_t* weights : {BT601_WEIGHTS, BT709_WEIGHTS}) {
+        for (int32_t width = 0; width < MAX_WIDTH; width++) {
+            std::vector<uint8_t> source = randomRow(random, static_cast<size_t>(width) * source_channels);
+            std::vector<uint8_t> expected(width);
+            std::vector<uint8_t> actual(width);
+            scalar(source.data(), expected.data(), width, weights);
+            kernel(source.data(), actual.data(), width, weights);
+            if (actual != expected) {
+                check(false, description);
+                return;
+            }
+        }
+    }
+}
+
+void testTiers() {
+    const Kernels scalar = selectKernels(CpuTier::Scalar);
+    std::mt19937 random(1);
+    forEachSimdTier([&](CpuTier tier) {
+        const Kernels kernels = selectKernels(tier);
+        checkRowKernel(random, kernels.rgbToRGBA, scalar.rgbToRGBA, 3, 4, "RGB to RGBA matches the scalar kernel");
+        checkRowKernel(random, kernels.rgbToBGRA, scalar.rgbToBGRA, 3, 4, "RGB to BGRA matches the scalar kernel");
+        checkRowKernel(random, kernels.rgbaToRGB, scalar.rgbaToRGB, 4, 3, "RGBA to RGB matches the scalar kernel");
+        checkRowKernel(random, kernels.rgbaToBGRA, scalar.rgbaToBGRA, 4, 4, "RGBA to BGRA matches the scalar kernel");
+        checkRowKernel(random, kernels.grayToRGBA, scalar.grayToRGBA, 1, 4, "Gray to RGBA matches the scalar kernel");
+        checkRowKernel(random, kernels.grayAlphaToRGBA, scalar.grayAlphaToRGBA, 2, 4, "Gray and alpha to RGBA matches the scalar kernel");
+        checkLumaKernel(random, kernels.rgbToGray, scalar.rgbToGray, 3, "RGB to gray matches the scalar kernel");
+        checkLumaKernel(random, kernels.rgbaToGray, scalar.rgbaToGray, 4, "RGBA to gray matches the scalar kernel");
+    });
+}
+
+void testWhiteStaysWhite() {
+    const int16_t* weights[] = {BT601_WEIGHTS, BT709_WEIGHTS};
+    for (const int16_t* luma : weights) {
+        uint8_t white[3] = {255, 255, 255};
+        uint8_t gray = 0;
+        colorToGray<3>(white, &gray, 1, luma);
+        check(gray == 255, "White converts to white gray");
+    }
+}
+
+void testStridedImage() {
+    // Rows padded well past their end, as in a crop of a larger image.
+    const int32_t width = 33;
+    const int32_t height = 5;
+    const size_t stride = 128;
+    Image image(width, height, 3, stride);
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width * 3; x++) {
+            image.getMutableBuffer()[y * stride + x] = static_cast<uint8_t>(x + y);
+        }
+    }
+
+    Image rgba = image.toRGBA();
+    check(rgba.getChannels() == 4 && rgba.getWidth() == width && rgba.getHeight() == height, "RGBA conversion keeps the dimensions");
+    const uint8_t* pixel = rgba.getBuffer() + 4 * rgba.getStride() + 2 * 4;
+    check(pixel[0] == 10 && pixel[1] == 11 && pixel[2] == 12 && pixel[3] == 255, "RGBA conversion reads the padded rows");
+
+    Image bgra = image.toBGRA();
+    check(bgra.getBuffer()[0] == 2 && bgra.getBuffer()[2] == 0 && bgra.getBuffer()[3] == 255, "BGRA conversion swaps red and blue");
+
+    Image rgb = rgba.toRGB();
+    bool same = true;
+    for (int32_t y = 0; y < height; y++) {
+        same = same && std::memcmp(rgb.getBuffer() + y * rgb.getStride(), image.getBuffer() + y * stride, width * 3) == 0;
+    }
+    check(same, "RGB to RGBA and back restores the image");
+
+    Image gray = image.toGray(Image::LumaWeights::BT709);
+    check(gray.getChannels() == 1 && gray.getWidth() == width, "Gray conversion keeps the dimensions");
+    Image expanded = gray.toRGBA();
+    check(expanded.getBuffer()[4] == gray.getBuffer()[1] && expanded.getBuffer()[7] == 255, "Gray to RGBA replicates the luma");
+}
+
+void testRejectsWideSamples() {
+    bool thrown = false;
+    try {
+        Image(4, 4, 3, Image::SampleType::U16).toRGBA();
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    check(thrown, "Converting 16-bit samples throws");
+}
+
+} // namespace
+
+int main() {
+    testTiers();
+    testWhiteStaysWhite();
+    testStridedImage();
+    testRejectsWideSamples();
+
+    return finishTest();
+}
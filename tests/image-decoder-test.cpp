@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <jpeglib.h>
+
+#include "image-decoder.h"
+#include "test-support.h"
+
+namespace {
+
+/**
+ * @brief Compresses a CMYK image with libjpeg, which marks it with an Adobe marker.
+ */
+std::vector<uint8_t> encodeCMYK(const std::vector<uint8_t>& pixels, int32_t width, int32_t height) {
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr error_manager;
+    cinfo.err = jpeg_std_error(&error_manager);
+    jpeg_create_compress(&cinfo);
+
+    unsigned char* data = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&cinfo, &data, &size);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 4;
+    cinfo.in_color_space = JCS_CMYK;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 95, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = const_cast<JSAMPROW>(pixels.data() + static_cast<size_t>(cinfo.next_scanline) * width * 4);
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    std::vector<uint8_t> encoded(data, data + size);
+    std::free(data);
+    return encoded;
+}
+
+/**
+ * @brief Largest difference between two decodes of the same size and channel count.
+ */
+int32_t getMaxDifference(const Image& a, const Image& b) {
+    int32_t difference = 0;
+    const size_t row_size = static_cast<size_t>(a.getWidth()) * a.getChannels();
+    for (int32_t y = 0; y < a.getHeight(); y++) {
+        for (size_t i = 0; i < row_size; i++) {
+            difference = std::max(difference, std::abs(a.getBuffer()[y * a.getStride() + i] - b.getBuffer()[y * b.getStride() + i]));
+        }
+    }
+    return difference;
+}
+
+/**
+ * @brief Checks that CMYK images decoded with libjpeg, which happens towards a target size, come out
+ * as stb_image decodes them at full size, for every channel count.
+ */
+void testCMYKMatchesStb() {
+    const int32_t width = 64;
+    const int32_t height = 64;
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            uint8_t* pixel = pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+            pixel[0] = static_cast<uint8_t>(100 + x);
+            pixel[1] = static_cast<uint8_t>(50 + y);
+            pixel[2] = static_cast<uint8_t>(25 + x + y);
+            pixel[3] = static_cast<uint8_t>(128 + x + y);
+        }
+    }
+    const std::vector<uint8_t> encoded = encodeCMYK(pixels, width, height);
+
+    for (int32_t channels = 1; channels <= 4; channels++) {
+        ImageDecoder stb;
+        stb.setChannels(channels);
+        const Image expected = stb.decodeImage(std::span<const uint8_t>(encoded));
+
+        ImageDecoder libjpeg;
+        libjpeg.setChannels(channels);
+        libjpeg.setTargetSize(width, height);
+        const Image actual = libjpeg.decodeImage(std::span<const uint8_t>(encoded));
+
+        check(actual.getWidth() == width && actual.getHeight() == height && actual.getChannels() == channels, "CMYK decodes keep the dimensions");
+        if (getMaxDifference(actual, expected) > 2) {
+            std::fprintf(stderr, "%d channels: difference %d\n", channels, getMaxDifference(actual, expected));
+            check(false, "CMYK decodes towards a target size match stb_image");
+        }
+    }
+
+    // Reduced by 1/8, the first pixel averages the colors of the top left 8x8 block.
+    ImageDecoder reduced;
+    reduced.setChannels(4);
+    reduced.setTargetSize(8, 8);
+    const Image thumbnail = reduced.decodeImage(std::span<const uint8_t>(encoded));
+    ImageDecoder stb;
+    stb.setChannels(4);
+    const Image full = stb.decodeImage(std::span<const uint8_t>(encoded));
+    bool close = thumbnail.getWidth() == 8 && thumbnail.getBuffer()[3] == 255;
+    for (int32_t c = 0; c < 3; c++) {
+        int32_t sum = 0;
+        for (int32_t y = 0; y < 8; y++) {
+            for (int32_t x = 0; x < 8; x++) {
+                sum += full.getBuffer()[y * full.getStride() + x * 4 + c];
+            }
+        }
+        close = close && std::abs(thumbnail.getBuffer()[c] - (sum + 32) / 64) <= 2;
+    }
+    check(close, "CMYK decodes reduced by 1/8 average the full decode of stb_image");
+}
+
+} // namespace
+
+int main() {
+    testCMYKMatchesStb();
+
+    return finishTest();
+}
@@ -0,0 +1,381 @@
+#include "../src/image-resizer.cpp"
+
+#include <numbers>
+#include <random>
+
+#include "test-support.h"
+
+namespace {
+
+const ImageResizer::Filter FILTERS[] = {
+    ImageResizer::Filter::Box,
+    ImageResizer::Filter::Bilinear,
+    ImageResizer::Filter::Bicubic,
+    ImageResizer::Filter::Lanczos3
+};
+
+const char* getFilterName(ImageResizer::Filter filter) {
+    switch (filter) {
+        case ImageResizer::Filter::Box:
+            return "box";
+        case ImageResizer::Filter::Bilinear:
+            return "bilinear";
+        case ImageResizer::Filter::Bicubic:
+            return "bicubic";
+        default:
+            return "Lanczos-3";
+    }
+}
+
+/**
+ * @brief A resize from a source size to a target size.
+ */
+struct Case {
+    int32_t source_width;
+    int32_t source_height;
+    int32_t target_width;
+    int32_t target_height;
+};
+
+/**
+ * @brief Reductions, enlargements, identical and degenerate sizes, with odd ratios. The last two
+ * are large enough to be split into several strips, which exercises the concurrent path.
+ */
+const Case CASES[] = {
+    {64, 48, 17, 13},
+    {17, 13, 64, 48},
+    {100, 80, 100, 80},
+    {1, 1, 5, 3},
+    {3, 2, 1, 1},
+    {5, 7, 2, 30},
+    {301, 203, 37, 41},
+    {40, 40, 39, 41},
+    {7, 300, 90, 4},
+    {600, 450, 250, 190},
+    {60, 50, 400, 600}
+};
+
+/**
+ * @brief Evaluates a filter at a distance in units of source samples, written out here from the
+ * definitions of the filters rather than taken from the resizer.
+ */
+double evaluateReferenceFilter(ImageResizer::Filter filter, double x) {
+    if (filter == ImageResizer::Filter::Box) {
+        // Half-open, so a sample exactly on the edge between two target samples counts for one only.
+        return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+    }
+    x = std::fabs(x);
+    switch (filter) {
+        case ImageResizer::Filter::Bilinear:
+            return std::max(0.0, 1.0 - x);
+        case ImageResizer::Filter::Bicubic:
+            // Catmull-Rom, the cubic convolution kernel with a = -0.5.
+            if (x < 1.0) {
+                return 1.5 * x * x * x - 2.5 * x * x + 1.0;
+            }
+            return x < 2.0 ? -0.5 * x * x * x + 2.5 * x * x - 4.0 * x + 2.0 : 0.0;
+        case ImageResizer::Filter::Lanczos3:
+            if (x == 0.0) {
+                return 1.0;
+            }
+            return x < 3.0 ? 3.0 * std::sin(std::numbers::pi * x) * std::sin(std::numbers::pi * x / 3.0) / (std::numbers::pi * std::numbers::pi * x * x) : 0.0;
+        default:
+            return 0.0;
+    }
+}
+
+/**
+ * @brief Computes the normalized weights of every source sample for every target sample of an axis.
+ * Sample i covers [i, i + 1), so its center is at i + 0.5 on both axes, and the filter is stretched
+ * by the scale when reducing. Samples past the edges are left out.
+ */
+std::vector<std::vector<double>> computeReferenceWeights(int32_t source_size, int32_t target_size, ImageResizer::Filter filter) {
+    const double scale = static_cast<double>(source_size) / target_size;
+    const double stretch = std::max(scale, 1.0);
+    std::vector<std::vector<double>> weights(target_size, std::vector<double>(source_size));
+    for (int32_t i = 0; i < target_size; i++) {
+        const double center = (i + 0.5) * scale;
+        double total = 0.0;
+        for (int32_t k = 0; k < source_size; k++) {
+            weights[i][k] = evaluateReferenceFilter(filter, (k + 0.5 - center) / stretch);
+            total += weights[i][k];
+        }
+        for (double& weight : weights[i]) {
+            weight /= total;
+        }
+    }
+    return weights;
+}
+
+/**
+ * @brief Resizes in double precision without intermediate rounding, into tightly packed rows.
+ */
+std::vector<uint8_t> resizeReference(const ImageView& source, int32_t width, int32_t height, ImageResizer::Filter filter) {
+    const int32_t channels = source.getChannels();
+    const size_t row_size = static_cast<size_t>(width) * channels;
+    const std::vector<std::vector<double>> horizontal = computeReferenceWeights(source.getWidth(), width, filter);
+    const std::vector<std::vector<double>> vertical = computeReferenceWeights(source.getHeight(), height, filter);
+
+    std::vector<double> intermediate(source.getHeight() * row_size);
+    for (int32_t y = 0; y < source.getHeight(); y++) {
+        const uint8_t* row = source.getRow(y);
+        for (int32_t x = 0; x < width; x++) {
+            for (int32_t k = 0; k < source.getWidth(); k++) {
+                if (horizontal[x][k] == 0.0) {
+                    continue;
+                }
+                for (int32_t c = 0; c < channels; c++) {
+                    intermediate[y * row_size + x * channels + c] += row[k * channels + c] * horizontal[x][k];
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> target(height * row_size);
+    std::vector<double> sums(row_size);
+    for (int32_t y = 0; y < height; y++) {
+        std::fill(sums.begin(), sums.end(), 0.0);
+        for (int32_t k = 0; k < source.getHeight(); k++) {
+            if (vertical[y][k] == 0.0) {
+                continue;
+            }
+            for (size_t i = 0; i < row_size; i++) {
+                sums[i] += intermediate[k * row_size + i] * vertical[y][k];
+            }
+        }
+        for (size_t i = 0; i < row_size; i++) {
+            target[y * row_size + i] = static_cast<uint8_t>(std::clamp(std::lround(sums[i]), 0L, 255L));
+        }
+    }
+    return target;
+}
+
+/**
+ * @brief Fills an image with noise and hard edges, which provoke the overshoot of sharpening filters.
+ */
+void fillWithNoise(std::mt19937& random, Image& image) {
+    for (int32_t y = 0; y < image.getHeight(); y++) {
+        uint8_t* row = image.getMutableBuffer() + y * image.getStride();
+        for (size_t x = 0; x < image.getStride(); x++) {
+            const uint32_t kind = random() % 3;
+            row[x] = kind == 0 ? 255 : kind == 1 ? 0 : static_cast<uint8_t>(random());
+        }
+    }
+}
+
+/**
+ * @brief Checks that the kernels of a tier filter exactly like the scalar ones, with the padded
+ * coefficients the resizer computes for them.
+ */
+void checkTier(std::mt19937& random, const Kernels& kernels, const Kernels& scalar, int32_t channels, const Case& size, ImageResizer::Filter filter) {
+    const int32_t width = size.target_width;
+    const size_t row_size = static_cast<size_t>(width) * channels;
+    const Coefficients horizontal = computeCoefficients(size.source_width, width, filter, horizontalAlignment(channels), channels == 3 ? 2 : 0);
+    const Coefficients vertical = computeCoefficients(size.source_height, size.target_height, filter, 1, 0);
+
+    // Each source row is allocated on its own and exactly sized, so that reads past its end trip
+    // memory checkers.
+    std::vector<std::vector<int16_t>> rows(size.source_height);
+    for (std::vector<int16_t>& row : rows) {
+        std::vector<uint8_t> source(static_cast<size_t>(size.source_width) * channels);
+        for (uint8_t& sample : source) {
+            sample = static_cast<uint8_t>(random());
+        }
+        row.resize(row_size);
+        std::vector<int16_t> actual(row_size);
+        scalar.horizontal[channels - 1](source.data(), row.data(), horizontal, width);
+        kernels.horizontal[channels - 1](source.data(), actual.data(), horizontal, width);
+        if (actual != row) {
+            check(false, "Horizontal kernel matches the scalar kernel");
+            return;
+        }
+    }
+
+    std::vector<const int16_t*> taps(vertical.taps);
+    std::vector<uint8_t> expected(row_size);
+    std::vector<uint8_t> actual(row_size);
+    for (int32_t y = 0; y < size.target_height; y++) {
+        for (int32_t k = 0; k < vertical.taps; k++) {
+            taps[k] = rows[vertical.starts[y] + k].data();
+        }
+        const int16_t* weights = vertical.weights.data() + static_cast<size_t>(y) * vertical.taps;
+        scalar.vertical(taps.data(), weights, vertical.taps, expected.data(), static_cast<int32_t>(row_size));
+        kernels.vertical(taps.data(), weights, vertical.taps, actual.data(), static_cast<int32_t>(row_size));
+        if (actual != expected) {
+            check(false, "Vertical kernel matches the scalar kernel");
+            return;
+        }
+    }
+}
+
+void testTiers() {
+    const Kernels scalar = selectKernels(CpuTier::Scalar);
+    std::mt19937 random(3);
+    forEachSimdTier([&](CpuTier tier) {
+        const Kernels kernels = selectKernels(tier);
+        for (int32_t channels = 1; channels <= 4; channels++) {
+            for (const Case& size : CASES) {
+                for (ImageResizer::Filter filter : FILTERS) {
+                    checkTier(random, kernels, scalar, channels, size, filter);
+                }
+            }
+        }
+    });
+}
+
+/**
+ * @brief Checks that resizing a crop of a padded image stays within one level of the exact result,
+ * on one thread and on several, into tightly packed and padded target rows.
+ */
+void testAgainstReference() {
+    std::mt19937 random(7);
+    ImageResizer serial;
+    ImageResizer concurrent;
+    concurrent.setConcurrency(3);
+    check(concurrent.getConcurrency() == 3, "Concurrency is kept");
+
+    for (int32_t channels = 1; channels <= 4; channels++) {
+        for (const Case& size : CASES) {
+            // The crop leaves a margin on every side, and the rows are padded by an odd amount.
+            Image padded(size.source_width + 6, size.source_height + 4, channels, static_cast<size_t>(size.source_width + 6) * channels + 13);
+            fillWithNoise(random, padded);
+            const ImageView source = ImageView(padded).crop(3, 2, size.source_width, size.source_height);
+
+            for (ImageResizer::Filter filter : FILTERS) {
+                serial.setFilter(filter);
+                concurrent.setFilter(filter);
+                const std::vector<uint8_t> expected = resizeReference(source, size.target_width, size.target_height, filter);
+
+                const Image one = serial.resize(source, size.target_width, size.target_height);
+                const size_t row_size = static_cast<size_t>(size.target_width) * channels;
+                const size_t stride = row_size + 5;
+                std::vector<uint8_t> three(stride * size.target_height);
+                concurrent.resize(source, three.data(), size.target_width, size.target_height, stride);
+
+                int32_t difference = 0;
+                bool same = true;
+                for (int32_t y = 0; y < size.target_height; y++) {
+                    for (size_t i = 0; i < row_size; i++) {
+                        const uint8_t sample = one.getBuffer()[y * one.getStride() + i];
+                        difference = std::max(difference, std::abs(sample - expected[y * row_size + i]));
+                        same = same && three[y * stride + i] == sample;
+                    }
+                }
+                if (difference > 1 || ! same) {
+                    std::fprintf(stderr, "%s, %d channels, %dx%d to %dx%d: difference %d, %s across threads\n", getFilterName(filter), channels,
+                                 size.source_width, size.source_height, size.target_width, size.target_height, difference, same ? "same" : "different");
+                }
+                check(difference <= 1, "Resizing stays within one level of the exact result");
+                check(same, "Resizing on several threads gives the same result");
+            }
+        }
+    }
+}
+
+void testConstantImagesStayConstant() {
+    for (ImageResizer::Filter filter : FILTERS) {
+        ImageResizer resizer(filter);
+        for (int32_t channels = 1; channels <= 4; channels++) {
+            for (const Case& size : CASES) {
+                Image flat(size.source_width, size.source_height, channels);
+                std::memset(flat.getMutableBuffer(), 200, flat.getBufferSize());
+                const Image resized = resizer.resize(flat, size.target_width, size.target_height);
+                bool same = true;
+                for (size_t i = 0; i < resized.getBufferSize(); i++) {
+                    same = same && resized.getBuffer()[i] == 200;
+                }
+                check(same, "A constant image stays constant");
+            }
+        }
+    }
+}
+
+void testSameSizeKeepsImage() {
+    std::mt19937 random(11);
+    Image image(23, 17, 3);
+    fillWithNoise(random, image);
+    for (ImageResizer::Filter filter : FILTERS) {
+        const Image resized = ImageResizer(filter).resize(image, image.getWidth(), image.getHeight());
+        check(std::memcmp(resized.getBuffer(), image.getBuffer(), image.getBufferSize()) == 0, "Resizing to the same size keeps the image");
+    }
+}
+
+void testBoxHalvingAveragesPairs() {
+    // Each 2x2 block of the source averages to a whole number: 16 * (x / 2 + y / 2) + 6.
+    for (int32_t channels = 1; channels <= 4; channels++) {
+        Image image(8, 6, channels);
+        for (int32_t y = 0; y < 6; y++) {
+            for (int32_t x = 0; x < 8; x++) {
+                const int32_t value = 16 * (x / 2 + y / 2) + 4 * (x % 2) + 8 * (y % 2);
+                std::memset(image.getMutableBuffer() + y * image.getStride() + x * channels, value, channels);
+            }
+        }
+        const Image halved = ImageResizer(ImageResizer::Filter::Box).resize(image, 4, 3);
+        bool averaged = true;
+        for (int32_t y = 0; y < 3; y++) {
+            for (int32_t x = 0; x < 4 * channels; x++) {
+                averaged = averaged && halved.getBuffer()[y * halved.getStride() + x] == 16 * (x / channels + y) + 6;
+            }
+        }
+        check(averaged, "Halving with the box filter averages pairs of samples");
+    }
+}
+
+void testBilinearDoublingInterpolatesRamp() {
+    // Target sample i lies at i / 2 - 1 / 4 in source samples, where the ramp 10 + 8 * k is 8 + 4 * i.
+    Image ramp(16, 1, 1);
+    for (int32_t k = 0; k < 16; k++) {
+        ramp.getMutableBuffer()[k] = static_cast<uint8_t>(10 + 8 * k);
+    }
+    const Image doubled = ImageResizer(ImageResizer::Filter::Bilinear).resize(ramp, 32, 1);
+    bool interpolated = true;
+    for (int32_t i = 1; i < 31; i++) {
+        interpolated = interpolated && doubled.getBuffer()[i] == 8 + 4 * i;
+    }
+    check(interpolated, "Doubling with the bilinear filter interpolates a ramp");
+    check(doubled.getBuffer()[0] == 10 && doubled.getBuffer()[31] == 130, "Doubling with the bilinear filter keeps the edges");
+}
+
+void testRejectsInvalidArguments() {
+    ImageResizer resizer;
+    Image image(4, 4, 3);
+
+    bool thrown = false;
+    try {
+        resizer.resize(image, 0, 10);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    check(thrown, "Resizing to an empty size throws");
+
+    thrown = false;
+    try {
+        resizer.resize(Image(4, 4, 3, Image::SampleType::U16), 2, 2);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    check(thrown, "Resizing 16-bit samples throws");
+
+    thrown = false;
+    uint8_t target[2 * 2 * 3];
+    try {
+        resizer.resize(image, target, 2, 2, 5);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    check(thrown, "Resizing with a stride smaller than a row throws");
+}
+
+} // namespace
+
+int main() {
+    testTiers();
+    testAgainstReference();
+    testConstantImagesStayConstant();
+    testSameSizeKeepsImage();
+    testBoxHalvingAveragesPairs();
+    testBilinearDoublingInterpolatesRamp();
+    testRejectsInvalidArguments();
+
+    return finishTest();
+}
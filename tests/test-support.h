@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "../src/cpu-features.h"
+
+/**
+ * Checks shared by the tests. A test reports failed checks through check() and returns finishTest()
+ * from main(). Tests of SIMD kernels include the implementation of the module they cover, so that
+ * they can reach the kernels of every instruction set tier rather than only those selected for the
+ * CPU running them.
+ */
+
+/**
+ * @brief Number of checks that failed so far.
+ */
+inline int test_failures = 0;
+
+/**
+ * @brief Records a failed check unless the condition holds.
+ */
+inline void check(bool condition, const char* description) {
+    if (! condition) {
+        std::fprintf(stderr, "FAILED: %s\n", description);
+        test_failures++;
+    }
+}
+
+/**
+ * @brief Reports the failed checks and returns the exit status of the test.
+ */
+inline int finishTest() {
+    if (test_failures > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", test_failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Runs a test for each SIMD tier the CPU supports, passing the tier, and reports the tiers
+ * that are skipped.
+ */
+template <typename Function>
+void forEachSimdTier(Function function) {
+    struct NamedTier {
+        CpuTier tier;
+        const char* name;
+    };
+    const NamedTier tiers[] = {
+        {CpuTier::SSSE3, "SSSE3"},
+        {CpuTier::AVX2, "AVX2"}
+    };
+    for (const NamedTier& tier : tiers) {
+        if (! isCpuTierSupported(tier.tier)) {
+            std::printf("Skipping the %s kernels, which this CPU does not support\n", tier.name);
+            continue;
+        }
+        std::printf("Testing the %s kernels\n", tier.name);
+        function(tier.tier);
+    }
+}
@@ -1,2 +1,13 @@
+#include <cstddef>
+
+// Route stb_image's allocations through the library's hooks (src/stb-allocator.cpp).
+void* stbAllocate(size_t size);
+void* stbReallocate(void* pointer, size_t old_size, size_t new_size);
+void stbFree(void* pointer);
+
+#define STBI_MALLOC(size) stbAllocate(size)
+#define STBI_REALLOC_SIZED(pointer, old_size, new_size) stbReallocate(pointer, old_size, new_size)
+#define STBI_FREE(pointer) stbFree(pointer)
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"